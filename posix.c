@@ -50,14 +50,15 @@
  * 1.a)
  *    readlink, strftime, times (useless return value)
  * 1.b)
- *    clock_gettime, clock_getres, sysinfo, uname, setenv, unsetenv, stat,
- *    stat, link, symlink, unlink, mkdir, rmdir, chmod, chown, lchown
+ *    clock_gettime, clock_getres, sysinfo, uname, setenv, unsetenv, setenvs,
+ *    stat, stat, link, symlink, unlink, mkdir, rmdir, chmod, chown, lchown,
+ *    mkpath, rmpath, walk
  * 1.c)
  *    localtime, gmtime, getpwnam, getpwuid, getgrnam, getgrgid
  * 2.
- *    time, umask
+ *    time, umask, monons, monocns
  * 3.
- *    openlog, syslog
+ *    openlog, syslog, tzset, acloselog, netcloselog, realns, realcns
  * 4.
  *    mktime
  *
@@ -85,6 +86,30 @@
  *   Example M code for openlog(2) POSIX function call:
  *     d &posix.openlog("program1","NDELAY|PID","USER")
  *
+ * Names can be resolved once into an integer token with $&posix.param(),
+ * the token is accepted in place of the names by all later calls, so hot
+ * paths skip the name lookup:
+ *     set errno=$&posix.param("priority","ERR",.err)
+ *     do &posix.syslog(err,"message")
+ *
+ *
+ * HANDLES
+ *
+ * Objects kept open between calls, like directories returned by opendir,
+ * are referenced from M with integer handles instead of raw pointers. The
+ * lower 24 bits of a handle index the process wide handle table, the upper
+ * bits hold the generation of the slot, bumped each time the slot is freed,
+ * so stale or made up handles are rejected with EINVAL in constant time.
+ * The table grows on demand, handle 0 (or "" in M) is never valid.
+ *
+ *
+ * RESULTS
+ *
+ * Calls with a name ending with "x" (e.g. readlinkx) have no fixed size
+ * output buffers, they keep the result in a process wide arena and return
+ * its length, the result is then pulled with $&posix.fetch(). The result
+ * is valid until the next such call.
+ *
  *
  * FILE MODE
  *
@@ -97,21 +122,54 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 #include <sys/times.h>
+#include <sys/resource.h>
 #include <sys/sysinfo.h>
 #include <sys/utsname.h>
 #include <syslog.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef STATX_BASIC_STATS
+#include <linux/stat.h>
+#endif
+#include <sys/sysmacros.h>
 #include <unistd.h>
 #include <time.h>
 #include <pwd.h>
 #include <grp.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "gtmxc_types.h"
 
 
@@ -120,9 +178,16 @@
 /* strlen (list_delimiter) == 1 */
 #define list_delimiter "|"
 
+/*
+ * directory entry names can contain any char except '/' and '\0', so the
+ * names returned in a single buffer are separated with '/'
+ */
+#define name_delimiter "/"
+#define line_delimiter "\n"
+
 typedef struct
 {
-	char *name;
+	const char *name;
 	int value;
 }
 param;
@@ -139,33 +204,379 @@ param;
 
 #define clear_errno() (errno = 0)
 
-#define get_param(x) _get_param (x##_param, sizeof (x##_param), x##_name, &x)
+/*
+ * Option tables, sorted in strcasecmp(3) order (note that '_' sorts before
+ * letters) for binary search.
+ */
+
+static const param clk_id_param[] = {
+	{ "MONOTONIC",		CLOCK_MONOTONIC },
+	{ "MONOTONIC_COARSE",	CLOCK_MONOTONIC_COARSE },
+	{ "MONOTONIC_RAW",	CLOCK_MONOTONIC_RAW },
+	{ "PROCESS_CPUTIME_ID",	CLOCK_PROCESS_CPUTIME_ID },
+	{ "REALTIME",		CLOCK_REALTIME },
+	{ "REALTIME_COARSE",	CLOCK_REALTIME_COARSE },
+	{ "THREAD_CPUTIME_ID",	CLOCK_THREAD_CPUTIME_ID }
+};
+
+static const param option_param[] = {
+	{ "CONS",	LOG_CONS },
+	{ "NDELAY",	LOG_NDELAY },
+	{ "NOWAIT",	LOG_NOWAIT },
+	{ "PID",	LOG_PID }
+};
+
+static const param facility_param[] = {
+	{ "AUTH",	LOG_AUTH },
+	{ "AUTHPRIV",	LOG_AUTHPRIV },
+	{ "CRON",	LOG_CRON },
+	{ "DAEMON",	LOG_DAEMON },
+	{ "FTP",	LOG_FTP },
+	{ "KERN",	LOG_KERN },
+	{ "LOCAL0",	LOG_LOCAL0 },
+	{ "LOCAL1",	LOG_LOCAL1 },
+	{ "LOCAL2",	LOG_LOCAL2 },
+	{ "LOCAL3",	LOG_LOCAL3 },
+	{ "LOCAL4",	LOG_LOCAL4 },
+	{ "LOCAL5",	LOG_LOCAL5 },
+	{ "LOCAL6",	LOG_LOCAL6 },
+	{ "LOCAL7",	LOG_LOCAL7 },
+	{ "LPR",	LOG_LPR },
+	{ "MAIL",	LOG_MAIL },
+	{ "NEWS",	LOG_NEWS },
+	{ "SYSLOG",	LOG_SYSLOG },
+	{ "USER",	LOG_USER },
+	{ "UUCP",	LOG_UUCP }
+};
+
+static const param priority_param[] = {
+	{ "ALERT",	LOG_ALERT },
+	{ "CRIT",	LOG_CRIT },
+	{ "DEBUG",	LOG_DEBUG },
+	{ "EMERG",	LOG_EMERG },
+	{ "ERR",	LOG_ERR },
+	{ "INFO",	LOG_INFO },
+	{ "NOTICE",	LOG_NOTICE },
+	{ "WARNING",	LOG_WARNING }
+};
+
+static const param tz_param[] = {
+	{ "LOCAL",	1 },
+	{ "UTC",	0 }
+};
+
+#define scan_stat 1
+#define scan_follow 2
+
+static const param scan_param[] = {
+	{ "FOLLOW",	scan_follow },
+	{ "STAT",	scan_stat }
+};
+
+/* no DIRECT, O_DIRECT needs aligned buffers, which GT.M strings are not */
+static const param open_flags_param[] = {
+	{ "APPEND",	O_APPEND },
+	{ "CREAT",	O_CREAT },
+	{ "DSYNC",	O_DSYNC },
+	{ "EXCL",	O_EXCL },
+	{ "NOATIME",	O_NOATIME },
+	{ "NOFOLLOW",	O_NOFOLLOW },
+	{ "RDONLY",	O_RDONLY },
+	{ "RDWR",	O_RDWR },
+	{ "SYNC",	O_SYNC },
+	{ "TRUNC",	O_TRUNC },
+	{ "WRONLY",	O_WRONLY }
+};
+
+#define copy_atomic 1
+#define copy_excl 2
+#define copy_mode 4
+#define copy_owner 8
+#define copy_times 16
+
+static const param copy_param[] = {
+	{ "ATOMIC",	copy_atomic },
+	{ "EXCL",	copy_excl },
+	{ "MODE",	copy_mode },
+	{ "OWNER",	copy_owner },
+	{ "PRESERVE",	copy_mode | copy_owner | copy_times },
+	{ "TIMES",	copy_times }
+};
+
+static const param watch_param[] = {
+	{ "ACCESS",		IN_ACCESS },
+	{ "ALL",		IN_ALL_EVENTS },
+	{ "ATTRIB",		IN_ATTRIB },
+	{ "CLOSE",		IN_CLOSE },
+	{ "CLOSE_NOWRITE",	IN_CLOSE_NOWRITE },
+	{ "CLOSE_WRITE",	IN_CLOSE_WRITE },
+	{ "CREATE",		IN_CREATE },
+	{ "DELETE",		IN_DELETE },
+	{ "DELETE_SELF",	IN_DELETE_SELF },
+	{ "MODIFY",		IN_MODIFY },
+	{ "MOVE",		IN_MOVE },
+	{ "MOVE_SELF",		IN_MOVE_SELF },
+	{ "MOVED_FROM",		IN_MOVED_FROM },
+	{ "MOVED_TO",		IN_MOVED_TO },
+	{ "OPEN",		IN_OPEN }
+};
+
+#define statx_nofollow (1 << 30)
+
+static const param statx_mask_param[] = {
+	{ "ALL",	STATX_BASIC_STATS | STATX_BTIME },
+	{ "ATIME",	STATX_ATIME },
+	{ "BASIC",	STATX_BASIC_STATS },
+	{ "BLOCKS",	STATX_BLOCKS },
+	{ "BTIME",	STATX_BTIME },
+	{ "CTIME",	STATX_CTIME },
+	{ "GID",	STATX_GID },
+	{ "INO",	STATX_INO },
+	{ "MODE",	STATX_MODE | STATX_TYPE },
+	{ "MTIME",	STATX_MTIME },
+	{ "NLINK",	STATX_NLINK },
+	{ "NOFOLLOW",	statx_nofollow },
+	{ "SIZE",	STATX_SIZE },
+	{ "UID",	STATX_UID }
+};
+
+static const param which_param[] = {
+	{ "PGRP",	PRIO_PGRP },
+	{ "PROCESS",	PRIO_PROCESS },
+	{ "USER",	PRIO_USER }
+};
+
+static const param policy_param[] = {
+	{ "BATCH",	SCHED_BATCH },
+	{ "FIFO",	SCHED_FIFO },
+	{ "IDLE",	SCHED_IDLE },
+	{ "OTHER",	SCHED_OTHER },
+	{ "RR",		SCHED_RR }
+};
+
+/* <numaif.h> is part of libnuma, not libc */
+#define mpol_default 0
+#define mpol_preferred 1
+#define mpol_bind 2
+#define mpol_interleave 3
+#define mpol_local 4
+/* MPOL_F_STATIC_NODES, MPOL_F_RELATIVE_NODES, MPOL_F_NUMA_BALANCING */
+#define mpol_mode_flags (~0u << 13)
+
+static const param mempolicy_param[] = {
+	{ "BIND",	mpol_bind },
+	{ "DEFAULT",	mpol_default },
+	{ "INTERLEAVE",	mpol_interleave },
+	{ "LOCAL",	mpol_local },
+	{ "PREFERRED",	mpol_preferred }
+};
+
+static const param rusage_param[] = {
+	{ "CHILDREN",	RUSAGE_CHILDREN },
+	{ "SELF",	RUSAGE_SELF },
+	{ "THREAD",	RUSAGE_THREAD }
+};
+
+static const param advice_param[] = {
+	{ "DONTNEED",	POSIX_FADV_DONTNEED },
+	{ "NOREUSE",	POSIX_FADV_NOREUSE },
+	{ "NORMAL",	POSIX_FADV_NORMAL },
+	{ "RANDOM",	POSIX_FADV_RANDOM },
+	{ "SEQUENTIAL",	POSIX_FADV_SEQUENTIAL },
+	{ "WILLNEED",	POSIX_FADV_WILLNEED }
+};
 
+#define map_hugepage 1
+#define map_populate 2
+#define map_random 4
+#define map_sequential 8
+#define map_willneed 16
+
+static const param map_param[] = {
+	{ "HUGEPAGE",	map_hugepage },
+	{ "POPULATE",	map_populate },
+	{ "RANDOM",	map_random },
+	{ "SEQUENTIAL",	map_sequential },
+	{ "WILLNEED",	map_willneed }
+};
+
+#define spawn_merge 1
+#define spawn_nonblock 2
+#define spawn_path 4
+#define spawn_pidfd 8
+#define spawn_setpgroup 16
+#define spawn_setsid 32
+#define spawn_stderr 64
+#define spawn_stdin 128
+#define spawn_stdout 256
+
+static const param spawn_param[] = {
+	{ "MERGE",	spawn_merge },
+	{ "NONBLOCK",	spawn_nonblock },
+	{ "PATH",	spawn_path },
+	{ "PIDFD",	spawn_pidfd },
+	{ "SETPGROUP",	spawn_setpgroup },
+	{ "SETSID",	spawn_setsid },
+	{ "STDERR",	spawn_stderr },
+	{ "STDIN",	spawn_stdin },
+	{ "STDOUT",	spawn_stdout }
+};
+
+static const param wait_flags_param[] = {
+	{ "CONTINUED",	WCONTINUED },
+	{ "NOHANG",	WNOHANG },
+	{ "UNTRACED",	WUNTRACED }
+};
+
+static const param poll_events_param[] = {
+	{ "ERR",	EPOLLERR },
+	{ "ET",		(int) EPOLLET },
+	{ "HUP",	EPOLLHUP },
+	{ "IN",		EPOLLIN },
+	{ "ONESHOT",	EPOLLONESHOT },
+	{ "OUT",	EPOLLOUT },
+	{ "PRI",	EPOLLPRI },
+	{ "RDHUP",	EPOLLRDHUP }
+};
+
+/* no ALRM and USR1, GT.M's timers and $ZINTERRUPT depend on them */
+static const param signo_param[] = {
+	{ "CHLD",	SIGCHLD },
+	{ "CONT",	SIGCONT },
+	{ "HUP",	SIGHUP },
+	{ "INT",	SIGINT },
+	{ "PIPE",	SIGPIPE },
+	{ "QUIT",	SIGQUIT },
+	{ "TERM",	SIGTERM },
+	{ "TSTP",	SIGTSTP },
+	{ "USR2",	SIGUSR2 },
+	{ "WINCH",	SIGWINCH }
+};
+
+#define param_entry(x, y, f) { x, y##_param, sizeof (y##_param) / sizeof (param), f }
+
+/* tables available to $&posix.param(), flags: "|" joined names are accepted */
+static const struct
+{
+	const char *name;
+	const param *p;
+	size_t n;
+	int flags;
+}
+param_list[] = {
+	param_entry ("advice",		advice, 0),
+	param_entry ("clock",		clk_id, 0),
+	param_entry ("copyfile",	copy, 1),
+	param_entry ("facility",	facility, 1),
+	param_entry ("mempolicy",	mempolicy, 0),
+	param_entry ("mmap",		map, 1),
+	param_entry ("open",		open_flags, 1),
+	param_entry ("option",		option, 1),
+	param_entry ("policy",		policy, 0),
+	param_entry ("poll",		poll_events, 1),
+	param_entry ("priority",	priority, 0),
+	param_entry ("rusage",		rusage, 0),
+	param_entry ("scandir",		scan, 1),
+	param_entry ("signal",		signo, 0),
+	param_entry ("spawn",		spawn, 1),
+	param_entry ("statx",		statx_mask, 1),
+	param_entry ("tz",		tz, 0),
+	param_entry ("wait",		wait_flags, 1),
+	param_entry ("watch",		watch, 1),
+	param_entry ("which",		which, 0)
+};
+
+static const param *
+_find_param (const param *p, size_t n, const char *name, size_t l)
+{
+	size_t lo = 0, hi = n, i;
+	int c;
+	while (lo < hi)
+	{
+		i = (lo + hi) / 2;
+		if ((c = strncasecmp (p[i].name, name, l)) == 0)
+			c = (p[i].name[l] != '\0');
+		if (c == 0)
+			return p + i;
+		if (c < 0)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return NULL;
+}
+
+/*
+ * An option can also be given as an integer token, resolved once with
+ * $&posix.param(), which saves the name lookup on hot paths.
+ */
 static int
-_get_param (param *p, size_t s, char *name, int *value)
+_get_token (const char *name, size_t l, int *value)
 {
-	unsigned int i;
-	for (i = 0; i < s / sizeof (param); i++)
-		if (strcasecmp (p[i].name, name) == 0)
-		{
-			*value = p[i].value;
-			return 0;
-		}
-	return -1;
+	char *e;
+	long v;
+	if (l == 0 || name[0] < '0' || name[0] > '9')
+		return -1;
+	v = strtol (name, &e, 10);
+	if (e != name + l)
+		return -1;
+	*value = v;
+	return 0;
+}
+
+static int
+_get_param_n (const param *p, size_t n, const char *name, size_t l, int *value)
+{
+	const param *b;
+	size_t i;
+	if (_get_token (name, l, value) == 0)
+	{
+		for (i = 0; i < n; i++)
+			if (p[i].value == *value)
+				return 0;
+		return -1;
+	}
+	if ((b = _find_param (p, n, name, l)) == NULL)
+		return -1;
+	*value = b -> value;
+	return 0;
 }
 
-#define get_flags(x) _get_flags (x##_param, sizeof (x##_param), x##_name, &x)
+#define get_param(x) _get_param (x##_param, sizeof (x##_param) / sizeof (param), x##_name, &x)
+
+static int
+_get_param (const param *p, size_t n, const char *name, int *value)
+{
+	return _get_param_n (p, n, name, strlen (name), value);
+}
+
+#define get_flags(x) _get_flags (x##_param, sizeof (x##_param) / sizeof (param), x##_name, &x)
+
+/* unlike strtok(3) based version, does not modify name */
 static int
-_get_flags (param *param, size_t s, char *name, int *value)
+_get_flags (const param *p, size_t n, const char *name, int *value)
 {
 	int flags = 0;
+	int all = 0;
 	int f;
-	char *p = strtok (name, list_delimiter);
-	while (p != NULL)
+	size_t i, l;
+	for (i = 0; i < n; i++)
+		all |= p[i].value;
+	while (*name != '\0')
 	{
-		check (_get_param (param, s, p, &f));
+		f = 0;
+		l = strcspn (name, list_delimiter);
+		if (_get_token (name, l, &f) == 0)
+		{
+			if ((f & ~all) != 0)
+				return -1;
+		}
+		else if (l > 0)
+			check (_get_param_n (p, n, name, l, &f));
 		flags |= f;
-		p = strtok (NULL, list_delimiter);
+		name += l;
+		if (*name != '\0')
+			name++;
 	}
 	*value = flags;
 	return 0;
@@ -201,28 +612,162 @@ strpncopy (char *p, char *s, ssize_t *n)
 	return NULL;
 }
 
-#define push_list(x, list, count) list[count++] = x
+/*
+ * Result arena, calls ending with "x" stash a result of any length here
+ * and return its length, M then pulls it with $&posix.fetch(), which hands
+ * GT.M a pointer into the arena instead of a preallocated output buffer.
+ * The arena is reused by the next call, it only grows.
+ */
+static struct
+{
+	char *p;
+	size_t len;
+	size_t size;
+}
+result;
 
-#define check_list(count, limit) \
-	do { \
-		if (count >= limit) \
-			return EMFILE; \
-	} while (0)
+static int
+_result_reserve (size_t n)
+{
+	char *p;
+	size_t s = result.size ? result.size : 4096;
+	if (n <= result.size)
+		return 0;
+	while (s < n)
+		s *= 2;
+	if ((p = realloc (result.p, s)) == NULL)
+		return ENOMEM;
+	result.p = p;
+	result.size = s;
+	return 0;
+}
 
+/* appends the strings to the result, returns errno */
 static int
-in_list (void *p, void **list, int *count, int remove)
+_result_append (const char *s, size_t l)
 {
-	int i;
-	for (i = 0; i < *count; i++)
-		if (list[i] == p)
-		{
-			if (remove)
-				list[i] = list[--(*count)];
-			return 1;
-		}
+	if (_result_reserve (result.len + l + 1) != 0)
+		return ENOMEM;
+	memcpy (result.p + result.len, s, l);
+	result.len += l;
+	result.p[result.len] = '\0';
+	return 0;
+}
+
+static int
+_result_set (const char *s, gtm_long_t *len)
+{
+	result.len = 0;
+	*len = 0;
+	if (_result_append (s, strlen (s)) != 0)
+		return ENOMEM;
+	*len = result.len;
+	return 0;
+}
+
+gtm_status_t
+posix_fetch (int argc, gtm_long_t offset, gtm_long_t len, gtm_string_t *s)
+{
+	check_argc (3);
+	s -> length = 0;
+	s -> address = result.p;
+	if (offset < 0 || len < 0)
+		return EINVAL;
+	if ((size_t) offset >= result.len)
+		return 0;
+	if ((size_t) len > result.len - offset)
+		len = result.len - offset;
+	/* the maximum M string length */
+	if (len > 1048576)
+		len = 1048576;
+	s -> address = result.p + offset;
+	s -> length = len;
+	return 0;
+}
+
+#define handle_bits 24
+#define handle_limit (1 << handle_bits)
+#define handle_gen_mask ((~(gtm_ulong_t) 0) >> handle_bits)
+
+enum
+{
+	handle_none = 0,
+	handle_dir,
+	handle_hist,
+	handle_map,
+	handle_fd,
+	handle_watch,
+	handle_counter,
+	handle_poll,
+	handle_signal
+};
+
+typedef struct
+{
+	void *p;
+	gtm_ulong_t gen;
+	int type;
+	unsigned int next;
+}
+handle;
+
+static handle *handle_list = NULL;
+static unsigned int handle_size = 0;
+static unsigned int handle_next = 0;
+
+static int
+handle_new (int type, void *p, gtm_ulong_t *h)
+{
+	handle *b;
+	unsigned int i, s;
+	if (handle_next == 0)
+	{
+		s = handle_size ? handle_size * 2 : 64;
+		if (s > handle_limit)
+			return EMFILE;
+		if ((b = realloc (handle_list, s * sizeof (handle))) == NULL)
+			return ENOMEM;
+		memset (b + handle_size, '\0', (s - handle_size) * sizeof (handle));
+		/* slot 0 is never used, so 0 (or "") is never a valid handle */
+		for (i = s - 1; i > handle_size && i > 0; i--)
+			b[i - 1].next = i;
+		handle_next = handle_size ? handle_size : 1;
+		handle_list = b;
+		handle_size = s;
+	}
+	i = handle_next;
+	handle_next = handle_list[i].next;
+	handle_list[i].p = p;
+	handle_list[i].type = type;
+	*h = (handle_list[i].gen << handle_bits) | i;
 	return 0;
 }
 
+static void *
+handle_get (gtm_ulong_t h, int type)
+{
+	gtm_ulong_t i = h & (handle_limit - 1);
+	if (i == 0 || i >= handle_size || handle_list[i].type != type ||
+		handle_list[i].gen != (h >> handle_bits))
+			return NULL;
+	return handle_list[i].p;
+}
+
+static void *
+handle_del (gtm_ulong_t h, int type)
+{
+	gtm_ulong_t i = h & (handle_limit - 1);
+	void *p;
+	if ((p = handle_get (h, type)) == NULL)
+		return NULL;
+	handle_list[i].p = NULL;
+	handle_list[i].type = handle_none;
+	handle_list[i].gen = (handle_list[i].gen + 1) & handle_gen_mask;
+	handle_list[i].next = handle_next;
+	handle_next = i;
+	return p;
+}
+
 gtm_ulong_t
 posix_time (int argc UNUSED)
 {
@@ -234,13 +779,6 @@ _posix_clock_get (int argc, gtm_char_t *clk_id_name, gtm_long_t *tv_sec, gtm_lon
 {
 	struct timespec b;
 	int clk_id;
-	param clk_id_param[] = {
-		{ "REALTIME",		CLOCK_REALTIME },
-		{ "MONOTONIC",		CLOCK_MONOTONIC },
-		{ "MONOTONIC_RAW",	CLOCK_MONOTONIC_RAW },
-		{ "PROCESS_CPUTIME_ID",	CLOCK_PROCESS_CPUTIME_ID },
-		{ "THREAD_CPUTIME_ID",	CLOCK_THREAD_CPUTIME_ID },
-	};
 	check_argc (3);
 	check (get_param (clk_id));
 	memset (&b, '\0', sizeof (b));
@@ -263,6 +801,114 @@ posix_clock_getres (int argc, gtm_char_t *clk_id_name, gtm_long_t *tv_sec, gtm_l
 	return _posix_clock_get (argc, clk_id_name, tv_sec, tv_nsec, 0);
 }
 
+/*
+ * Nanoseconds since the clock epoch as a single integer, no clock name is
+ * looked up and there are no output parameters, clock_gettime(2) is served
+ * by vDSO, "COARSE" clocks trade the resolution (a tick) for speed. Unix
+ * time in nanoseconds has 19 digits, more than the 18 digits of GT.M
+ * numbers, so the realtime clocks are returned as strings.
+ */
+static gtm_long_t
+_posix_clock_ns (clockid_t clk_id)
+{
+	struct timespec b;
+	clock_gettime (clk_id, &b);
+	return (gtm_long_t) b.tv_sec * 1000000000 + b.tv_nsec;
+}
+
+gtm_long_t
+posix_monons (int argc UNUSED)
+{
+	return _posix_clock_ns (CLOCK_MONOTONIC);
+}
+
+void
+posix_realns (int argc UNUSED, gtm_char_t *ns /* [32] */)
+{
+	snprintf (ns, 32, "%lld", (long long) _posix_clock_ns (CLOCK_REALTIME));
+}
+
+gtm_long_t
+posix_monocns (int argc UNUSED)
+{
+	return _posix_clock_ns (CLOCK_MONOTONIC_COARSE);
+}
+
+void
+posix_realcns (int argc UNUSED, gtm_char_t *ns /* [32] */)
+{
+	snprintf (ns, 32, "%lld", (long long) _posix_clock_ns (CLOCK_REALTIME_COARSE));
+}
+
+/*
+ * Broken-down time cache, localtime_r(3) is converting the time using the
+ * TZ rules loaded once (unlike localtime(3), which may reload them on every
+ * call), and for the same day and UTC offset as the last conversion, the
+ * time is computed from the cached start of the day. The cache is valid
+ * only for days without UTC offset change (or leap second), other days are
+ * always converted by libc. tzset^posix reloads the TZ rules.
+ */
+
+typedef struct
+{
+	time_t start;
+	time_t end;
+	struct tm tm;
+}
+day_cache;
+
+static day_cache day_local;
+static day_cache day_utc;
+
+static struct tm *
+_time_r (time_t t, struct tm *tm, int local)
+{
+	return local ? localtime_r (&t, tm) : gmtime_r (&t, tm);
+}
+
+static struct tm *
+_time_cached (time_t t, struct tm *tm, int local)
+{
+	day_cache *c = local ? &day_local : &day_utc;
+	struct tm b;
+	time_t s;
+	if (t >= c -> start && t < c -> end)
+	{
+		s = t - c -> start;
+		*tm = c -> tm;
+		tm -> tm_hour = s / 3600;
+		tm -> tm_min = s / 60 % 60;
+		tm -> tm_sec = s % 60;
+		return tm;
+	}
+	if (_time_r (t, tm, local) == NULL)
+		return NULL;
+	c -> start = c -> end = 0;
+	s = t - (tm -> tm_hour * 3600 + tm -> tm_min * 60 + tm -> tm_sec);
+	if (_time_r (s, &c -> tm, local) == NULL || c -> tm.tm_hour != 0 || c -> tm.tm_min != 0 ||
+		c -> tm.tm_sec != 0 || c -> tm.tm_mday != tm -> tm_mday || c -> tm.tm_gmtoff != tm -> tm_gmtoff)
+			return tm;
+	if (_time_r (s + 86399, &b, local) == NULL || b.tm_hour != 23 || b.tm_min != 59 ||
+		b.tm_sec != 59 || b.tm_mday != tm -> tm_mday || b.tm_gmtoff != tm -> tm_gmtoff)
+			return tm;
+	c -> start = s;
+	c -> end = s + 86400;
+	return tm;
+}
+
+static void
+_time_reset (void)
+{
+	tzset ();
+	memset (&day_local, '\0', sizeof (day_local));
+}
+
+void
+posix_tzset (int argc UNUSED)
+{
+	_time_reset ();
+}
+
 static gtm_status_t
 _posix_time (int argc, gtm_long_t* t,
 	gtm_int_t *tm_sec, gtm_int_t *tm_min, gtm_int_t *tm_hour, gtm_int_t *tm_mday, gtm_int_t *tm_mon,
@@ -270,9 +916,10 @@ _posix_time (int argc, gtm_long_t* t,
 	int local)
 {
 	struct tm *b;
+	struct tm tm;
 	check_argc (10);
 	clear_errno ();
-	if ((b = local ? localtime (t) : gmtime (t)) != NULL)
+	if ((b = _time_cached (*t, &tm, local)) != NULL)
 	{
 		*tm_sec = b -> tm_sec;
 		*tm_min = b -> tm_min;
@@ -359,6 +1006,203 @@ posix_strftime (int argc,
 	return errno;
 }
 
+/* strftime(3) straight from unix time */
+gtm_status_t
+posix_formattime (int argc, gtm_char_t *format, gtm_long_t t, gtm_char_t *tz_name, gtm_char_t *s /* [1024] */)
+{
+	struct tm b;
+	int tz;
+	check_argc (4);
+	s[0] = '\0';
+	check (get_param (tz));
+	clear_errno ();
+	if (_time_cached (t, &b, tz) == NULL)
+		return errno;
+	if (strftime (s, 1024, format, &b) == 0 && format[0] != '\0')
+	{
+		s[0] = '\0';
+		return ERANGE;
+	}
+	return 0;
+}
+
+/*
+ * Vectorized time conversions, list is "|" separated values, the results
+ * are returned "|" separated in the same order. The number of list bytes
+ * consumed is returned, so that the rest of the list can be passed to the
+ * next call when the output buffer is full. Sorted lists benefit from the
+ * day cache, where time of the same day as the previous value is computed
+ * without libc conversion.
+ */
+
+#define timev_strftime 0
+#define timev_localtime 1
+#define timev_mktime 2
+
+#define horolog_epoch 47117	/* $H day of 1970-01-01 */
+
+/* civil from days, proleptic Gregorian calendar */
+static void
+_civil (long z, int *y, int *m, int *d)
+{
+	long era, doe, yoe, doy, mp;
+	z += 719468;
+	era = (z >= 0 ? z : z - 146096) / 146097;
+	doe = z - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	*y = yoe + era * 400 + (*m <= 2);
+}
+
+static long
+_floor_div (long a, long b)
+{
+	return (a >= 0 ? a : a - b + 1) / b;
+}
+
+static int
+_horolog_to_time (long day, long sec, int local, time_t *t)
+{
+	day_cache *c = &day_local;
+	struct tm b, x;
+	int y, m, d;
+	if (!local)
+	{
+		*t = (day - horolog_epoch) * 86400 + sec;
+		return 0;
+	}
+	if (c -> end > c -> start && sec >= 0 && sec < 86400 &&
+		_floor_div (c -> start + c -> tm.tm_gmtoff, 86400) + horolog_epoch == day)
+	{
+		*t = c -> start + sec;
+		return 0;
+	}
+	memset (&b, '\0', sizeof (b));
+	_civil (day - horolog_epoch, &y, &m, &d);
+	b.tm_year = y - 1900;
+	b.tm_mon = m - 1;
+	b.tm_mday = d;
+	b.tm_hour = sec / 3600;
+	b.tm_min = sec / 60 % 60;
+	b.tm_sec = sec % 60;
+	b.tm_isdst = -1;
+	clear_errno ();
+	if ((*t = mktime (&b)) == (time_t) -1 && errno != 0)
+		return errno;
+	/* load the day cache */
+	_time_cached (*t, &x, 1);
+	return 0;
+}
+
+static gtm_status_t
+_posix_timev (int op, gtm_char_t *format, gtm_char_t *list, gtm_char_t *tz_name,
+	gtm_int_t *consumed, gtm_char_t *out /* [65536] */)
+{
+	char b[1024];
+	struct tm tm;
+	ssize_t s = 65536;
+	char *p = out;
+	char *q = list;
+	char *e, *start;
+	size_t l;
+	long v, sec;
+	time_t t;
+	int tz, n = 0;
+	out[0] = '\0';
+	*consumed = 0;
+	check (get_param (tz));
+	for (;;)
+	{
+		start = q;
+		b[0] = '\0';
+		if (*q != '\0' && *q != list_delimiter[0])
+		{
+			v = strtol (q, &e, 10);
+			if (e == q)
+				return EINVAL;
+			clear_errno ();
+			switch (op)
+			{
+				case timev_strftime:
+				case timev_localtime:
+					if (_time_cached (v, &tm, tz) == NULL)
+						return errno;
+					if (op == timev_strftime)
+						strftime (b, sizeof (b), format, &tm);
+					else
+						snprintf (b, sizeof (b), "%ld,%d",
+							_floor_div (v + tm.tm_gmtoff, 86400) + horolog_epoch,
+							tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec);
+					break;
+				case timev_mktime:
+					sec = 0;
+					if (*e == ',')
+					{
+						q = e + 1;
+						sec = strtol (q, &e, 10);
+						if (e == q)
+							return EINVAL;
+					}
+					if ((errno = _horolog_to_time (v, sec, tz, &t)) != 0)
+						return errno;
+					snprintf (b, sizeof (b), "%lld", (long long) t);
+					break;
+			}
+			if (*e != '\0' && *e != list_delimiter[0])
+				return EINVAL;
+			q = e;
+		}
+		l = strlen (b);
+		if ((ssize_t) l + (n > 0) >= s)
+		{
+			if (n == 0)
+				return ERANGE;
+			q = start;
+			break;
+		}
+		if (n++ > 0)
+		{
+			*p++ = list_delimiter[0];
+			s--;
+		}
+		memcpy (p, b, l + 1);
+		p += l;
+		s -= l;
+		if (*q == '\0')
+			break;
+		q++;
+	}
+	*consumed = q - list;
+	return 0;
+}
+
+gtm_status_t
+posix_strftimev (int argc, gtm_char_t *format, gtm_char_t *list, gtm_char_t *tz_name,
+	gtm_int_t *consumed, gtm_char_t *out /* [65536] */)
+{
+	check_argc (5);
+	return _posix_timev (timev_strftime, format, list, tz_name, consumed, out);
+}
+
+gtm_status_t
+posix_localtimev (int argc, gtm_char_t *list, gtm_char_t *tz_name,
+	gtm_int_t *consumed, gtm_char_t *out /* [65536] */)
+{
+	check_argc (4);
+	return _posix_timev (timev_localtime, "", list, tz_name, consumed, out);
+}
+
+gtm_status_t
+posix_mktimev (int argc, gtm_char_t *list, gtm_char_t *tz_name,
+	gtm_int_t *consumed, gtm_char_t *out /* [65536] */)
+{
+	check_argc (4);
+	return _posix_timev (timev_mktime, "", list, tz_name, consumed, out);
+}
+
 gtm_status_t
 posix_times(int argc,
 	gtm_long_t *tms_utime, gtm_long_t *tms_stime, gtm_long_t *tms_cutime, gtm_long_t *tms_cstime)
@@ -409,38 +1253,650 @@ posix_sysinfo(int argc,
 	return errno;
 }
 
-
+/* times in microseconds, maxrss in kilobytes */
 gtm_status_t
-posix_uname (int argc,
-	gtm_char_t *sysname /* [128] */, gtm_char_t *nodename /* [128] */,
-	gtm_char_t *release /* [128] */, gtm_char_t *version /* [128] */,
-	gtm_char_t *machine /* [128] */)
+posix_getrusage (int argc, gtm_char_t *rusage_name,
+	gtm_long_t *utime, gtm_long_t *stime, gtm_long_t *maxrss,
+	gtm_long_t *minflt, gtm_long_t *majflt, gtm_long_t *nvcsw, gtm_long_t *nivcsw,
+	gtm_long_t *inblock, gtm_long_t *oublock)
 {
-	struct utsname b;
-	check_argc (5);
+	struct rusage b;
+	int rusage;
+	check_argc (10);
+	check (get_param (rusage));
+	memset (&b, '\0', sizeof (b));
 	clear_errno ();
-	sysname[0] = '\0';
-	nodename[0] = '\0';
-	release[0] = '\0';
-	version[0] = '\0';
-	machine[0] = '\0';
-	if (uname (&b) == 0)
+	if (getrusage (rusage, &b) == 0)
 	{
-		if (strncopy (sysname, b.sysname, 128) ||
-			strncopy (nodename, b.nodename, 128) ||
-			strncopy (release, b.release, 128) ||
-			strncopy (version, b.version, 128) ||
-			strncopy (machine, b.machine, 128))
-				return ERANGE;
+		*utime = (gtm_long_t) b.ru_utime.tv_sec * 1000000 + b.ru_utime.tv_usec;
+		*stime = (gtm_long_t) b.ru_stime.tv_sec * 1000000 + b.ru_stime.tv_usec;
+		*maxrss = b.ru_maxrss;
+		*minflt = b.ru_minflt;
+		*majflt = b.ru_majflt;
+		*nvcsw = b.ru_nvcsw;
+		*nivcsw = b.ru_nivcsw;
+		*inblock = b.ru_inblock;
+		*oublock = b.ru_oublock;
 	}
 	return errno;
 }
 
-gtm_status_t
-posix_setenv (int argc, gtm_char_t *name, gtm_char_t *value, gtm_int_t overwrite)
+/*
+ * /proc/self files are opened once and read with pread(2) at offset 0,
+ * so a sample costs a single syscall. They are reopened in the child
+ * after fork, /proc/self is resolved at open time.
+ */
+static struct
+{
+	int io;
+	int statm;
+}
+proc_fd = { -1, -1 };
+
+static void
+_proc_atfork_child (void)
+{
+	if (proc_fd.io != -1)
+		close (proc_fd.io);
+	if (proc_fd.statm != -1)
+		close (proc_fd.statm);
+	proc_fd.io = proc_fd.statm = -1;
+}
+
+static int
+_proc_read (int *fd, const char *path, char *b, size_t s)
+{
+	static int atfork = 0;
+	ssize_t l;
+	if (*fd == -1)
+	{
+		if (!atfork && pthread_atfork (NULL, NULL, _proc_atfork_child) == 0)
+			atfork = 1;
+		if ((*fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+			return errno;
+	}
+	while ((l = pread (*fd, b, s - 1, 0)) == -1)
+		if (errno != EINTR)
+			return errno;
+	b[l] = '\0';
+	return 0;
+}
+
+/* I/O counters of the process, see proc(5) /proc/[pid]/io */
+gtm_status_t
+posix_procio (int argc,
+	gtm_ulong_t *rchar, gtm_ulong_t *wchar, gtm_ulong_t *syscr, gtm_ulong_t *syscw,
+	gtm_ulong_t *read_bytes, gtm_ulong_t *write_bytes, gtm_ulong_t *cancelled_write_bytes)
+{
+	char b[512];
+	char *p;
+	int e;
+	check_argc (7);
+	*rchar = *wchar = *syscr = *syscw = *read_bytes = *write_bytes = *cancelled_write_bytes = 0;
+	if ((e = _proc_read (&proc_fd.io, "/proc/self/io", b, sizeof (b))) != 0)
+		return e;
+	for (p = b; p != NULL && *p; p = strchr (p, '\n'), p = p ? p + 1 : NULL)
+	{
+		unsigned long long v;
+		char k[32];
+		if (sscanf (p, "%31[^:]: %llu", k, &v) != 2)
+			continue;
+		if (strcmp (k, "rchar") == 0)
+			*rchar = v;
+		else if (strcmp (k, "wchar") == 0)
+			*wchar = v;
+		else if (strcmp (k, "syscr") == 0)
+			*syscr = v;
+		else if (strcmp (k, "syscw") == 0)
+			*syscw = v;
+		else if (strcmp (k, "read_bytes") == 0)
+			*read_bytes = v;
+		else if (strcmp (k, "write_bytes") == 0)
+			*write_bytes = v;
+		else if (strcmp (k, "cancelled_write_bytes") == 0)
+			*cancelled_write_bytes = v;
+	}
+	return 0;
+}
+
+/* memory usage of the process in bytes, see proc(5) /proc/[pid]/statm */
+gtm_status_t
+posix_statm (int argc,
+	gtm_ulong_t *size, gtm_ulong_t *resident, gtm_ulong_t *shared, gtm_ulong_t *text, gtm_ulong_t *data)
+{
+	static long page = 0;
+	unsigned long v[7];
+	char b[256];
+	int e;
+	check_argc (5);
+	*size = *resident = *shared = *text = *data = 0;
+	if ((e = _proc_read (&proc_fd.statm, "/proc/self/statm", b, sizeof (b))) != 0)
+		return e;
+	if (sscanf (b, "%lu %lu %lu %lu %lu %lu %lu", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+		return EINVAL;
+	if (page == 0)
+		page = sysconf (_SC_PAGESIZE);
+	*size = v[0] * page;
+	*resident = v[1] * page;
+	*shared = v[2] * page;
+	*text = v[3] * page;
+	*data = v[5] * page;
+	return 0;
+}
+
+/*
+ * Node metrics sampler, the /proc files are kept open and re-read with
+ * pread(2) into a static buffer, counters are turned into rates against
+ * the previous sample. The result is a flat "|" joined list of
+ * "name=value" pairs, e.g. "cpu.user=12.50|disk.sda.rps=3.00|...", the
+ * rates are missing from the first sample.
+ */
+
+#define metrics_devices 64
+#define metrics_name_size 32
+
+enum
+{
+	metrics_stat,
+	metrics_loadavg,
+	metrics_diskstats,
+	metrics_netdev,
+	metrics_psi_cpu,
+	metrics_psi_io,
+	metrics_psi_memory,
+	metrics_files
+};
+
+static const char *metrics_path[metrics_files] = {
+	"/proc/stat",
+	"/proc/loadavg",
+	"/proc/diskstats",
+	"/proc/net/dev",
+	"/proc/pressure/cpu",
+	"/proc/pressure/io",
+	"/proc/pressure/memory"
+};
+
+typedef struct
+{
+	char name[metrics_name_size];
+	unsigned long long v[5];
+}
+metrics_counter;
+
+static struct
+{
+	int init;
+	int fd[metrics_files];
+	double t;
+	unsigned long long cpu[8];
+	unsigned long long ctxt;
+	metrics_counter disk[metrics_devices];
+	int disks;
+	metrics_counter net[metrics_devices];
+	int nets;
+	/* grows for the intr line of /proc/stat, which is long with many CPUs and IRQs */
+	char *buf;
+	size_t size;
+}
+metrics;
+
+#define metrics_buf_limit (64 << 20)
+
+/* reads the whole file k into metrics.buf, returns errno */
+static int
+_metrics_read (int k)
+{
+	char *b;
+	int e;
+	for (;;)
+	{
+		if (metrics.size != 0)
+		{
+			if ((e = _proc_read (&metrics.fd[k], metrics_path[k], metrics.buf, metrics.size)) != 0)
+				return e;
+			/* a full buffer may be truncated, /proc files give no size */
+			if (strlen (metrics.buf) < metrics.size - 1)
+				return 0;
+			if (metrics.size >= metrics_buf_limit)
+				return EFBIG;
+		}
+		if ((b = realloc (metrics.buf, metrics.size ? metrics.size * 2 : 131072)) == NULL)
+			return ENOMEM;
+		metrics.buf = b;
+		metrics.size = metrics.size ? metrics.size * 2 : 131072;
+	}
+}
+
+typedef struct
+{
+	char *p;
+	size_t s;
+	int n;
+	int full;
+}
+metrics_out;
+
+static void
+_metric (metrics_out *o, const char *prefix, const char *name, const char *field, double v, int decimals)
+{
+	int l;
+	if (o -> full)
+		return;
+	l = snprintf (o -> p, o -> s, "%s%s%s%s%s=%.*f", (o -> n ? list_delimiter : ""),
+		prefix, (name ? "." : ""), (name ? name : ""), field, decimals, v);
+	if (l < 0 || (size_t) l >= o -> s)
+	{
+		/* the pair does not fit, drop it */
+		o -> p[0] = '\0';
+		o -> full = 1;
+		return;
+	}
+	o -> p += l;
+	o -> s -= l;
+	o -> n++;
+}
+
+static double
+_rate (unsigned long long now, unsigned long long prev, double dt)
+{
+	return (now >= prev && dt > 0) ? (now - prev) / dt : 0;
+}
+
+/* finds (or adds) the previous counters of a device */
+static metrics_counter *
+_metrics_device (metrics_counter *c, int *n, const char *name, int *found)
+{
+	int i;
+	*found = 0;
+	for (i = 0; i < *n; i++)
+		if (strcmp (c[i].name, name) == 0)
+		{
+			*found = 1;
+			return c + i;
+		}
+	if (*n >= metrics_devices)
+		return NULL;
+	memset (c + *n, '\0', sizeof (metrics_counter));
+	strncopy (c[*n].name, (char *) name, metrics_name_size);
+	return c + (*n)++;
+}
+
+static void
+_metrics_psi (metrics_out *o, const char *name, char *b)
+{
+	char prefix[32];
+	char kind[8];
+	double a10, a60, a300;
+	char *p;
+	for (p = b; p != NULL && *p; p = strchr (p, '\n'), p = p ? p + 1 : NULL)
+		if (sscanf (p, "%7s avg10=%lf avg60=%lf avg300=%lf", kind, &a10, &a60, &a300) == 4)
+		{
+			snprintf (prefix, sizeof (prefix), "psi.%s.%s", name, kind);
+			_metric (o, prefix, NULL, ".avg10", a10, 2);
+			_metric (o, prefix, NULL, ".avg60", a60, 2);
+			_metric (o, prefix, NULL, ".avg300", a300, 2);
+		}
+}
+
+/* truncated: 1 when not all the pairs fit into out, the ones which fit are returned */
+gtm_status_t
+posix_metrics (int argc, gtm_char_t *out /* [65536] */, gtm_int_t *truncated)
+{
+	metrics_out o = { out, 65536, 0, 0 };
+	metrics_counter *c;
+	unsigned long long v[10], total, prev_total;
+	char name[metrics_name_size];
+	struct timespec ts;
+	double t, dt = 0;
+	double a1, a5, a15;
+	int first, found;
+	int i, k, e;
+	char *p;
+	check_argc (2);
+	out[0] = '\0';
+	*truncated = 0;
+	if (!metrics.init)
+	{
+		for (i = 0; i < metrics_files; i++)
+			metrics.fd[i] = -1;
+		metrics.init = 1;
+	}
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	t = ts.tv_sec + ts.tv_nsec / 1e9;
+	first = (metrics.t == 0);
+	if (!first)
+		dt = t - metrics.t;
+	metrics.t = t;
+	if (_metrics_read (metrics_loadavg) == 0 &&
+		sscanf (metrics.buf, "%lf %lf %lf", &a1, &a5, &a15) == 3)
+	{
+		_metric (&o, "load", NULL, "1", a1, 2);
+		_metric (&o, "load", NULL, "5", a5, 2);
+		_metric (&o, "load", NULL, "15", a15, 2);
+	}
+	if ((e = _metrics_read (metrics_stat)) != 0)
+		return e;
+	memset (v, '\0', sizeof (v));
+	/* user nice system idle iowait irq softirq steal */
+	if (sscanf (metrics.buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) >= 4)
+	{
+		for (total = prev_total = 0, i = 0; i < 8; i++)
+		{
+			total += v[i];
+			prev_total += metrics.cpu[i];
+		}
+		if (!first && total > prev_total)
+		{
+			double d = (total - prev_total) / 100.0;
+			_metric (&o, "cpu", NULL, ".user", (v[0] + v[1] - metrics.cpu[0] - metrics.cpu[1]) / d, 2);
+			_metric (&o, "cpu", NULL, ".system", (v[2] + v[5] + v[6] - metrics.cpu[2] - metrics.cpu[5] - metrics.cpu[6]) / d, 2);
+			_metric (&o, "cpu", NULL, ".idle", (v[3] - metrics.cpu[3]) / d, 2);
+			_metric (&o, "cpu", NULL, ".iowait", (v[4] - metrics.cpu[4]) / d, 2);
+			_metric (&o, "cpu", NULL, ".steal", (v[7] - metrics.cpu[7]) / d, 2);
+		}
+		memcpy (metrics.cpu, v, sizeof (metrics.cpu));
+	}
+	for (p = metrics.buf; p != NULL && *p; p = strchr (p, '\n'), p = p ? p + 1 : NULL)
+	{
+		if (sscanf (p, "ctxt %llu", &v[0]) == 1)
+		{
+			if (!first)
+				_metric (&o, "ctxt", NULL, ".ps", _rate (v[0], metrics.ctxt, dt), 2);
+			metrics.ctxt = v[0];
+		}
+		else if (sscanf (p, "procs_running %llu", &v[0]) == 1)
+			_metric (&o, "procs", NULL, ".running", v[0], 0);
+		else if (sscanf (p, "procs_blocked %llu", &v[0]) == 1)
+			_metric (&o, "procs", NULL, ".blocked", v[0], 0);
+	}
+	/* reads, sectors read, writes, sectors written, ms doing I/O */
+	if (_metrics_read (metrics_diskstats) == 0)
+		for (p = metrics.buf; p != NULL && *p; p = strchr (p, '\n'), p = p ? p + 1 : NULL)
+		{
+			if (sscanf (p, "%*u %*u %31s %llu %*u %llu %*u %llu %*u %llu %*u %*u %llu",
+				name, &v[0], &v[1], &v[2], &v[3], &v[4]) != 6)
+				continue;
+			if (strncmp (name, "loop", 4) == 0 || strncmp (name, "ram", 3) == 0)
+				continue;
+			if ((c = _metrics_device (metrics.disk, &metrics.disks, name, &found)) == NULL)
+				continue;
+			if (found && !first)
+			{
+				_metric (&o, "disk", name, ".rps", _rate (v[0], c -> v[0], dt), 2);
+				_metric (&o, "disk", name, ".rkbs", _rate (v[1], c -> v[1], dt) / 2, 2);
+				_metric (&o, "disk", name, ".wps", _rate (v[2], c -> v[2], dt), 2);
+				_metric (&o, "disk", name, ".wkbs", _rate (v[3], c -> v[3], dt) / 2, 2);
+				_metric (&o, "disk", name, ".util", _rate (v[4], c -> v[4], dt) / 10, 2);
+			}
+			memcpy (c -> v, v, sizeof (c -> v));
+		}
+	/* rx bytes, rx packets, tx bytes, tx packets */
+	if (_metrics_read (metrics_netdev) == 0)
+		for (p = metrics.buf; p != NULL && *p; p = strchr (p, '\n'), p = p ? p + 1 : NULL)
+		{
+			if (sscanf (p, " %31[^:]: %llu %llu %*u %*u %*u %*u %*u %*u %llu %llu",
+				name, &v[0], &v[1], &v[2], &v[3]) != 5)
+				continue;
+			if ((c = _metrics_device (metrics.net, &metrics.nets, name, &found)) == NULL)
+				continue;
+			if (found && !first)
+			{
+				_metric (&o, "net", name, ".rxbs", _rate (v[0], c -> v[0], dt), 2);
+				_metric (&o, "net", name, ".rxpps", _rate (v[1], c -> v[1], dt), 2);
+				_metric (&o, "net", name, ".txbs", _rate (v[2], c -> v[2], dt), 2);
+				_metric (&o, "net", name, ".txpps", _rate (v[3], c -> v[3], dt), 2);
+			}
+			memcpy (c -> v, v, 4 * sizeof (unsigned long long));
+		}
+	/* pressure stall information, kernel 4.20+ */
+	for (k = metrics_psi_cpu; k <= metrics_psi_memory; k++)
+		if (metrics.fd[k] != -2)
+		{
+			if (_metrics_read (k) != 0)
+			{
+				/* not supported, not tried again */
+				if (metrics.fd[k] == -1)
+					metrics.fd[k] = -2;
+				continue;
+			}
+			_metrics_psi (&o, metrics_path[k] + strlen ("/proc/pressure/"), metrics.buf);
+		}
+	*truncated = o.full;
+	return 0;
+}
+
+/*
+ * CPU and NUMA node lists in the form used by taskset -c and numactl,
+ * e.g. "0-7,16", parsed into (and formatted from) bitmaps of bits bits.
+ */
+
+#define bitlist_bits 1024
+#define bitlist_word (8 * sizeof (unsigned long))
+
+static int
+_bitlist_parse (const char *s, unsigned long *mask, size_t bits)
+{
+	unsigned long a, b;
+	char *e;
+	memset (mask, '\0', bits / 8);
+	while (*s)
+	{
+		a = strtoul (s, &e, 10);
+		if (e == s)
+			return EINVAL;
+		b = a;
+		if (*e == '-')
+		{
+			s = e + 1;
+			b = strtoul (s, &e, 10);
+			if (e == s || b < a)
+				return EINVAL;
+		}
+		if (b >= bits)
+			return EINVAL;
+		for (; a <= b; a++)
+			mask[a / bitlist_word] |= 1UL << (a % bitlist_word);
+		if (*e != ',' && *e != '\0')
+			return EINVAL;
+		s = (*e == ',') ? e + 1 : e;
+	}
+	return 0;
+}
+
+static void
+_bitlist_format (const unsigned long *mask, size_t bits, char *o, size_t s)
+{
+	size_t i, j;
+	size_t l = 0;
+	o[0] = '\0';
+	for (i = 0; i < bits; i = j)
+	{
+		if (!(mask[i / bitlist_word] & (1UL << (i % bitlist_word))))
+		{
+			j = i + 1;
+			continue;
+		}
+		for (j = i + 1; j < bits && (mask[j / bitlist_word] & (1UL << (j % bitlist_word))); j++)
+			;
+		if (l < s)
+			l += (j - 1 > i) ? snprintf (o + l, s - l, "%s%zu-%zu", (l ? "," : ""), i, j - 1)
+				: snprintf (o + l, s - l, "%s%zu", (l ? "," : ""), i);
+	}
+}
+
+/*
+ * pid 0 is the calling thread only (on Linux pid is a thread id), threads
+ * started before, like the asyslog writer and the tree workers, keep their
+ * own masks, threads started later inherit the mask.
+ */
+gtm_status_t
+posix_setaffinity (int argc, gtm_long_t pid, gtm_char_t *cpus)
+{
+	cpu_set_t set;
+	check_argc (2);
+	check (_bitlist_parse (cpus, (unsigned long *) &set, sizeof (set) * 8));
+	clear_errno ();
+	sched_setaffinity (pid, sizeof (set), &set);
+	return errno;
+}
+
+gtm_status_t
+posix_getaffinity (int argc, gtm_long_t pid, gtm_char_t *cpus /* [4096] */)
+{
+	cpu_set_t set;
+	check_argc (2);
+	cpus[0] = '\0';
+	clear_errno ();
+	if (sched_getaffinity (pid, sizeof (set), &set) == 0)
+		_bitlist_format ((unsigned long *) &set, sizeof (set) * 8, cpus, 4096);
+	return errno;
+}
+
+/* the CPU and NUMA node the calling thread is running on */
+gtm_status_t
+posix_getcpu (int argc, gtm_int_t *cpu, gtm_int_t *node)
+{
+	unsigned int c = 0, n = 0;
+	check_argc (2);
+	clear_errno ();
+	syscall (SYS_getcpu, &c, &n, NULL);
+	*cpu = c;
+	*node = n;
+	return errno;
+}
+
+gtm_status_t
+posix_setpriority (int argc, gtm_char_t *which_name, gtm_long_t who, gtm_int_t prio)
+{
+	int which;
+	check_argc (3);
+	check (get_param (which));
+	clear_errno ();
+	setpriority (which, who, prio);
+	return errno;
+}
+
+gtm_status_t
+posix_getpriority (int argc, gtm_char_t *which_name, gtm_long_t who, gtm_int_t *prio)
+{
+	int which;
+	check_argc (3);
+	check (get_param (which));
+	/* -1 is a valid priority, see getpriority(2) */
+	clear_errno ();
+	*prio = getpriority (which, who);
+	return errno;
+}
+
+gtm_status_t
+posix_setscheduler (int argc, gtm_long_t pid, gtm_char_t *policy_name, gtm_int_t priority)
+{
+	struct sched_param p;
+	int policy;
+	check_argc (3);
+	check (get_param (policy));
+	memset (&p, '\0', sizeof (p));
+	p.sched_priority = priority;
+	clear_errno ();
+	sched_setscheduler (pid, policy, &p);
+	return errno;
+}
+
+gtm_status_t
+posix_getscheduler (int argc, gtm_long_t pid, gtm_char_t *policy_name /* [16] */, gtm_int_t *priority)
+{
+	struct sched_param p;
+	size_t i;
+	int policy;
+	check_argc (3);
+	policy_name[0] = '\0';
+	*priority = 0;
+	clear_errno ();
+	if ((policy = sched_getscheduler (pid)) == -1 || sched_getparam (pid, &p) == -1)
+		return errno;
+	*priority = p.sched_priority;
+	/* SCHED_RESET_ON_FORK may be or-ed in */
+	for (i = 0; i < sizeof (policy_param) / sizeof (param); i++)
+		if (policy_param[i].value == (policy & ~SCHED_RESET_ON_FORK))
+			strncopy (policy_name, (char *) policy_param[i].name, 16);
+	return 0;
+}
+
+/* memory policy of the calling thread, through the raw syscalls, without libnuma */
+gtm_status_t
+posix_setmempolicy (int argc, gtm_char_t *mempolicy_name, gtm_char_t *nodes)
+{
+	unsigned long mask[bitlist_bits / bitlist_word];
+	int mempolicy;
+	check_argc (2);
+	check (get_param (mempolicy));
+	check (_bitlist_parse (nodes, mask, bitlist_bits));
+	clear_errno ();
+	if (mempolicy == mpol_default || mempolicy == mpol_local)
+		syscall (SYS_set_mempolicy, mempolicy, NULL, 0);
+	else
+		syscall (SYS_set_mempolicy, mempolicy, mask, bitlist_bits + 1);
+	return errno;
+}
+
+gtm_status_t
+posix_getmempolicy (int argc, gtm_char_t *mempolicy_name /* [16] */, gtm_char_t *nodes /* [4096] */)
+{
+	unsigned long mask[bitlist_bits / bitlist_word];
+	size_t i;
+	int mode = 0;
+	check_argc (2);
+	mempolicy_name[0] = '\0';
+	nodes[0] = '\0';
+	memset (mask, '\0', sizeof (mask));
+	clear_errno ();
+	if (syscall (SYS_get_mempolicy, &mode, mask, bitlist_bits, NULL, 0) == -1)
+		return errno;
+	/* mode flags, like MPOL_F_STATIC_NODES set by numactl, are the bits from 13 up */
+	for (i = 0; i < sizeof (mempolicy_param) / sizeof (param); i++)
+		if (mempolicy_param[i].value == (int) (mode & ~mpol_mode_flags))
+			strncopy (mempolicy_name, (char *) mempolicy_param[i].name, 16);
+	_bitlist_format (mask, bitlist_bits, nodes, 4096);
+	return 0;
+}
+
+
+gtm_status_t
+posix_uname (int argc,
+	gtm_char_t *sysname /* [128] */, gtm_char_t *nodename /* [128] */,
+	gtm_char_t *release /* [128] */, gtm_char_t *version /* [128] */,
+	gtm_char_t *machine /* [128] */)
+{
+	struct utsname b;
+	check_argc (5);
+	clear_errno ();
+	sysname[0] = '\0';
+	nodename[0] = '\0';
+	release[0] = '\0';
+	version[0] = '\0';
+	machine[0] = '\0';
+	if (uname (&b) == 0)
+	{
+		if (strncopy (sysname, b.sysname, 128) ||
+			strncopy (nodename, b.nodename, 128) ||
+			strncopy (release, b.release, 128) ||
+			strncopy (version, b.version, 128) ||
+			strncopy (machine, b.machine, 128))
+				return ERANGE;
+	}
+	return errno;
+}
+
+gtm_status_t
+posix_setenv (int argc, gtm_char_t *name, gtm_char_t *value, gtm_int_t overwrite)
 {
 	check_argc (3);
+	clear_errno ();
 	setenv (name, value, overwrite);
+	if (strcmp (name, "TZ") == 0)
+		_time_reset ();
 	return errno;
 }
 
@@ -448,10 +1904,77 @@ gtm_status_t
 posix_unsetenv (int argc, gtm_char_t *name)
 {
 	check_argc (1);
+	clear_errno ();
 	unsetenv (name);
+	if (strcmp (name, "TZ") == 0)
+		_time_reset ();
 	return errno;
 }
 
+/* the whole environment to the result, "name=value" entries terminated by NUL */
+gtm_status_t
+posix_environx (int argc, gtm_long_t *len)
+{
+	extern char **environ;
+	size_t l = 0;
+	char **e;
+	check_argc (1);
+	*len = 0;
+	result.len = 0;
+	for (e = environ; *e != NULL; e++)
+		l += strlen (*e) + 1;
+	if (_result_reserve (l + 1) != 0)
+		return ENOMEM;
+	for (e = environ; *e != NULL; e++)
+	{
+		l = strlen (*e) + 1;
+		memcpy (result.p + result.len, *e, l);
+		result.len += l;
+	}
+	result.p[result.len] = '\0';
+	*len = result.len;
+	return 0;
+}
+
+/* env: "name=value" entries terminated by NUL, stops at the first failing entry */
+gtm_status_t
+posix_setenvs (int argc, gtm_string_t *env, gtm_int_t overwrite)
+{
+	char b[4096], *n = b, *p, *q, *end, *v;
+	int tz = 0, e = 0;
+	check_argc (2);
+	if (env -> length >= sizeof (b) && (n = malloc (env -> length + 1)) == NULL)
+		return ENOMEM;
+	memcpy (n, env -> address, env -> length);
+	n[env -> length] = '\0';
+	for (p = n, end = n + env -> length; p < end; p = q + 1)
+	{
+		if ((q = memchr (p, '\0', end - p)) == NULL)
+			q = end;
+		if (q == p)
+			continue;
+		if ((v = strchr (p, '=')) == NULL || v == p)
+		{
+			e = EINVAL;
+			break;
+		}
+		*v = '\0';
+		if (setenv (p, v + 1, overwrite) == -1)
+		{
+			e = errno;
+			break;
+		}
+		tz |= strcmp (p, "TZ") == 0;
+	}
+	if (tz)
+		_time_reset ();
+	if (n != b)
+		free (n);
+	return e;
+}
+
+static const char *log_ident = NULL;
+
 gtm_status_t
 posix_openlog (int argc, gtm_char_t *ident, gtm_char_t *option_name, gtm_char_t *facility_name)
 {
@@ -459,34 +1982,6 @@ posix_openlog (int argc, gtm_char_t *ident, gtm_char_t *option_name, gtm_char_t
 	int facility;
 	char *p;
 	size_t s;
-	param option_param[] = {
-		{ "CONS",	LOG_CONS },
-		{ "NDELAY",	LOG_NDELAY },
-		{ "NOWAIT",	LOG_NOWAIT },
-		{ "PID",	LOG_PID }
-	};
-	param facility_param[] = {
-		{ "AUTH",	LOG_AUTH },
-		{ "AUTHPRIV",	LOG_AUTHPRIV },
-		{ "CRON",	LOG_CRON },
-		{ "DAEMON",	LOG_DAEMON },
-		{ "FTP",	LOG_FTP },
-		{ "KERN",	LOG_KERN },
-		{ "LOCAL0",	LOG_LOCAL0 },
-		{ "LOCAL1",	LOG_LOCAL1 },
-		{ "LOCAL2",	LOG_LOCAL2 },
-		{ "LOCAL3",	LOG_LOCAL3 },
-		{ "LOCAL4",	LOG_LOCAL4 },
-		{ "LOCAL5",	LOG_LOCAL5 },
-		{ "LOCAL6",	LOG_LOCAL6 },
-		{ "LOCAL7",	LOG_LOCAL7 },
-		{ "LPR",	LOG_LPR },
-		{ "MAIL",	LOG_MAIL },
-		{ "NEWS",	LOG_NEWS },
-		{ "SYSLOG",	LOG_SYSLOG },
-		{ "USER",	LOG_USER },
-		{ "UUCP",	LOG_UUCP }
-	};
 	check_argc (3);
 	s = strlen (ident) + 1;
 	clear_errno ();
@@ -503,6 +1998,8 @@ posix_openlog (int argc, gtm_char_t *ident, gtm_char_t *option_name, gtm_char_t
 	check (get_flags (option));
 	check (get_flags (facility));
 	openlog (p, option, facility);
+	/* also the default APP-NAME for netopenlog */
+	log_ident = p;
 	return errno;
 }
 
@@ -510,16 +2007,6 @@ gtm_status_t
 posix_syslog (int argc, gtm_char_t *priority_name, gtm_char_t *message)
 {
 	int priority;
-	param priority_param[] = {
-		{ "EMERG",	LOG_EMERG },
-		{ "ALERT",	LOG_ALERT },
-		{ "CRIT",	LOG_CRIT },
-		{ "ERR",	LOG_ERR },
-		{ "WARNING",	LOG_WARNING },
-		{ "NOTICE",	LOG_NOTICE },
-		{ "INFO",	LOG_INFO },
-		{ "DEBUG",	LOG_DEBUG },
-	};
 	check_argc (2);
 	check (get_param (priority));
 	clear_errno ();
@@ -527,9 +2014,612 @@ posix_syslog (int argc, gtm_char_t *priority_name, gtm_char_t *message)
 	return errno;
 }
 
-gtm_ulong_t
-posix_umask (int argc, gtm_ulong_t mask)
-{
+/*
+ * Asynchronous syslog, messages are formatted by the calling process into
+ * a single producer, single consumer lock-free ring and sent to the local
+ * syslog socket by a background thread, in batches with sendmmsg(2) where
+ * available, so the M process never blocks when syslogd stalls. Messages
+ * are dropped (and counted) when the ring is full. The background thread
+ * runs with all signals blocked and sleeps on an eventfd when the ring
+ * is empty.
+ */
+
+#define alog_path "/dev/log"
+#define alog_msg_size 2048
+#define alog_batch 64
+#define alog_slots 512
+
+typedef struct
+{
+	size_t len;
+	char data[alog_msg_size];
+}
+alog_msg;
+
+static struct
+{
+	int running;
+	int fd;
+	int efd;
+	int stream;
+	int option;
+	int facility;
+	char ident[64];
+	alog_msg *ring;
+	unsigned long size;
+	/* written by one side only, read by the other with acquire, see _alog_writer and posix_asyslog */
+	unsigned long head;
+	unsigned long tail;
+	volatile int sleeping;
+	volatile int stop;
+	volatile gtm_ulong_t sent;
+	volatile gtm_ulong_t dropped;
+	volatile gtm_ulong_t failed;
+	pthread_t thread;
+}
+alog;
+
+static int
+_alog_connect (void)
+{
+	struct sockaddr_un a;
+	int fd;
+	memset (&a, '\0', sizeof (a));
+	a.sun_family = AF_UNIX;
+	strncopy (a.sun_path, alog_path, sizeof (a.sun_path));
+	alog.stream = 0;
+	if ((fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) == -1)
+		return -1;
+	if (connect (fd, (struct sockaddr *) &a, sizeof (a)) == -1)
+	{
+		close (fd);
+		if (errno != EPROTOTYPE)
+			return -1;
+		if ((fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+			return -1;
+		if (connect (fd, (struct sockaddr *) &a, sizeof (a)) == -1)
+		{
+			close (fd);
+			return -1;
+		}
+		alog.stream = 1;
+	}
+	return fd;
+}
+
+/* sends the rest of a partially sent message, so the stream stays framed */
+static int
+_alog_send_rest (const char *p, size_t len)
+{
+	struct pollfd f;
+	ssize_t r;
+	while (len > 0)
+	{
+		if ((r = send (alog.fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				return -1;
+			f.fd = alog.fd;
+			f.events = POLLOUT;
+			if (poll (&f, 1, 1000) == 0 && alog.stop)
+				return -1;
+			continue;
+		}
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+/* sends n messages starting from tail, returns number of messages consumed */
+static unsigned long
+_alog_send (unsigned long tail, unsigned long n)
+{
+	ssize_t s;
+	struct mmsghdr m[alog_batch];
+	struct iovec v[alog_batch];
+	struct pollfd p;
+	alog_msg *b;
+	unsigned long i;
+	int r;
+	if (alog.fd == -1 && (alog.fd = _alog_connect ()) == -1)
+	{
+		alog.failed += n;
+		return n;
+	}
+	memset (m, '\0', n * sizeof (struct mmsghdr));
+	for (i = 0; i < n; i++)
+	{
+		b = alog.ring + ((tail + i) & (alog.size - 1));
+		v[i].iov_base = b -> data;
+		/* stream sockets get '\0' terminated messages, like syslog(3) does */
+		v[i].iov_len = b -> len + alog.stream;
+		m[i].msg_hdr.msg_iov = v + i;
+		m[i].msg_hdr.msg_iovlen = 1;
+	}
+	while ((r = sendmmsg (alog.fd, m, n, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1 && errno == EINTR)
+		;
+	if (r == -1 && errno == ENOSYS)
+	{
+		/* kernel < 3.0 */
+		for (r = 0; (unsigned long) r < n; r++)
+		{
+			if ((s = sendmsg (alog.fd, &m[r].msg_hdr, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1)
+				break;
+			m[r].msg_len = s;
+			if ((size_t) s < v[r].iov_len)
+			{
+				r++;
+				break;
+			}
+		}
+		if (r == 0)
+			r = -1;
+	}
+	if (r > 0)
+	{
+		/* only the last message sent to a stream socket can be partial */
+		for (i = 0; i < (unsigned long) r; i++)
+			if (m[i].msg_len < v[i].iov_len)
+			{
+				if (_alog_send_rest ((char *) v[i].iov_base + m[i].msg_len, v[i].iov_len - m[i].msg_len) == -1)
+				{
+					/* the framing is lost, the next message starts on a new connection */
+					close (alog.fd);
+					alog.fd = -1;
+					alog.sent += i;
+					alog.failed++;
+					return i + 1;
+				}
+				r = i + 1;
+				break;
+			}
+		alog.sent += r;
+		return r;
+	}
+	if (errno == EAGAIN)
+	{
+		/* syslogd is busy, wait for it, but do not hang acloselog forever */
+		p.fd = alog.fd;
+		p.events = POLLOUT;
+		if (poll (&p, 1, 1000) != 0 || !alog.stop)
+			return 0;
+		alog.failed += n;
+		return n;
+	}
+	/* syslogd restarted or gone, the message is dropped and reconnect is tried next time */
+	close (alog.fd);
+	alog.fd = -1;
+	alog.failed++;
+	return 1;
+}
+
+static void *
+_alog_writer (void *arg UNUSED)
+{
+	struct pollfd p;
+	unsigned long n, tail;
+	uint64_t e;
+	for (;;)
+	{
+		tail = alog.tail;
+		/* pairs with the release of head, the slots up to head are complete */
+		if ((n = __atomic_load_n (&alog.head, __ATOMIC_ACQUIRE) - tail) == 0)
+		{
+			if (alog.stop)
+				break;
+			alog.sleeping = 1;
+			__sync_synchronize ();
+			if (__atomic_load_n (&alog.head, __ATOMIC_ACQUIRE) == tail && !alog.stop)
+			{
+				p.fd = alog.efd;
+				p.events = POLLIN;
+				if (poll (&p, 1, 1000) > 0)
+					while (read (alog.efd, &e, sizeof (e)) == -1 && errno == EINTR)
+						;
+			}
+			alog.sleeping = 0;
+			continue;
+		}
+		if (n > alog_batch)
+			n = alog_batch;
+		n = _alog_send (tail, n);
+		/* the slots can be reused by the producer once it sees the new tail */
+		__atomic_store_n (&alog.tail, tail + n, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void
+_alog_wake (void)
+{
+	uint64_t e = 1;
+	__sync_synchronize ();
+	if (alog.sleeping)
+		while (write (alog.efd, &e, sizeof (e)) == -1 && errno == EINTR)
+			;
+}
+
+static void
+_alog_stop (void)
+{
+	alog.stop = 1;
+	_alog_wake ();
+	pthread_join (alog.thread, NULL);
+	if (alog.fd != -1)
+		close (alog.fd);
+	close (alog.efd);
+	free (alog.ring);
+	alog.running = 0;
+}
+
+/* the writer thread does not exist in the child, fall back to syslog(3) there */
+static void
+_alog_atfork_child (void)
+{
+	alog.running = 0;
+}
+
+gtm_status_t
+posix_aopenlog (int argc, gtm_char_t *ident, gtm_char_t *option_name, gtm_char_t *facility_name,
+	gtm_int_t slots)
+{
+	static int atfork = 0;
+	int option;
+	int facility;
+	sigset_t all, old;
+	unsigned long s;
+	int e;
+	check_argc (4);
+	check (get_flags (option));
+	check (get_flags (facility));
+	if (alog.running)
+		_alog_stop ();
+	memset (&alog, '\0', sizeof (alog));
+	strncopy (alog.ident, ident, sizeof (alog.ident));
+	alog.option = option;
+	alog.facility = facility;
+	if (slots <= 0)
+		slots = alog_slots;
+	for (s = 16; s < (unsigned long) slots && s < (1 << 20); s *= 2)
+		;
+	alog.size = s;
+	clear_errno ();
+	if ((alog.ring = malloc (s * sizeof (alog_msg))) == NULL)
+		return errno;
+	if ((alog.efd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+	{
+		free (alog.ring);
+		return errno;
+	}
+	/* not connected is not an error, syslogd may show up later */
+	alog.fd = _alog_connect ();
+	sigfillset (&all);
+	pthread_sigmask (SIG_SETMASK, &all, &old);
+	e = pthread_create (&alog.thread, NULL, _alog_writer, NULL);
+	pthread_sigmask (SIG_SETMASK, &old, NULL);
+	if (e != 0)
+	{
+		if (alog.fd != -1)
+			close (alog.fd);
+		close (alog.efd);
+		free (alog.ring);
+		return e;
+	}
+	if (!atfork && pthread_atfork (NULL, NULL, _alog_atfork_child) == 0)
+		atfork = 1;
+	alog.running = 1;
+	return 0;
+}
+
+gtm_status_t
+posix_asyslog (int argc, gtm_char_t *priority_name, gtm_char_t *message)
+{
+	static const char *mon[] = {
+		"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+	};
+	struct tm tm;
+	alog_msg *b;
+	unsigned long head = alog.head;
+	int priority;
+	int l;
+	check_argc (2);
+	check (get_param (priority));
+	if (!alog.running)
+	{
+		syslog (priority, "%s", message);
+		return 0;
+	}
+	/* pairs with the release of tail, the writer is done with the slots before tail */
+	if (head - __atomic_load_n (&alog.tail, __ATOMIC_ACQUIRE) >= alog.size)
+	{
+		alog.dropped++;
+		return 0;
+	}
+	b = alog.ring + (head & (alog.size - 1));
+	_time_cached (time (NULL), &tm, 1);
+	if (alog.option & LOG_PID)
+		l = snprintf (b -> data, alog_msg_size, "<%d>%s %2d %02d:%02d:%02d %s[%d]: %s",
+			priority | alog.facility, mon[tm.tm_mon], tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+			alog.ident, (int) getpid (), message);
+	else
+		l = snprintf (b -> data, alog_msg_size, "<%d>%s %2d %02d:%02d:%02d %s: %s",
+			priority | alog.facility, mon[tm.tm_mon], tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+			alog.ident, message);
+	b -> len = (l < alog_msg_size) ? l : alog_msg_size - 1;
+	/* publish the message with the head */
+	__atomic_store_n (&alog.head, head + 1, __ATOMIC_RELEASE);
+	_alog_wake ();
+	return 0;
+}
+
+/* waits until all queued messages are sent, timeout in milliseconds */
+gtm_status_t
+posix_aflushlog (int argc, gtm_int_t timeout)
+{
+	struct timespec t = { 0, 1000000 };
+	check_argc (1);
+	if (!alog.running)
+		return 0;
+	while (__atomic_load_n (&alog.tail, __ATOMIC_ACQUIRE) != alog.head)
+	{
+		if (timeout-- <= 0)
+			return ETIMEDOUT;
+		nanosleep (&t, NULL);
+	}
+	return 0;
+}
+
+void
+posix_acloselog (int argc UNUSED)
+{
+	if (alog.running)
+		_alog_stop ();
+}
+
+gtm_status_t
+posix_alogstat (int argc, gtm_ulong_t *queued, gtm_ulong_t *sent, gtm_ulong_t *dropped, gtm_ulong_t *failed)
+{
+	check_argc (4);
+	*queued = alog.head - __atomic_load_n (&alog.tail, __ATOMIC_ACQUIRE);
+	*sent = alog.sent;
+	*dropped = alog.dropped;
+	*failed = alog.failed;
+	return 0;
+}
+
+/*
+ * RFC 5424 syslog sent directly to a unix, UDP or TCP target, bypassing
+ * syslog(3) and the local syslogd hop. The constant part of the header
+ * (HOSTNAME APP-NAME PROCID) is formatted once by netopenlog, so every
+ * message costs one snprintf and one send(2). TCP uses octet counting
+ * framing (RFC 6587), unix stream sockets get '\0' terminated messages.
+ *
+ * Targets:
+ *   "/dev/log" or "unix:/dev/log"
+ *   "udp:loghost:514", "udp:[::1]:514"
+ *   "tcp:loghost:601"
+ */
+
+#define nlog_msg_size 65536
+
+static struct
+{
+	int fd;
+	int stream;
+	int tcp;
+	int facility;
+	pid_t pid;
+	char target[256];
+	char app[64];
+	char head[512];
+	char buf[nlog_msg_size];
+}
+nlog = { -1 };
+
+static int
+_nlog_connect (void)
+{
+	struct addrinfo hints, *ai, *a;
+	struct sockaddr_un u;
+	char host[256];
+	char *t = nlog.target;
+	char *port;
+	int fd = -1;
+	int e;
+	nlog.stream = 0;
+	nlog.tcp = 0;
+	if (strncasecmp (t, "unix:", 5) == 0 || t[0] == '/')
+	{
+		if (t[0] != '/')
+			t += 5;
+		memset (&u, '\0', sizeof (u));
+		u.sun_family = AF_UNIX;
+		if (strncopy (u.sun_path, t, sizeof (u.sun_path)))
+			return -ENAMETOOLONG;
+		if ((fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) == -1)
+			return -errno;
+		if (connect (fd, (struct sockaddr *) &u, sizeof (u)) == 0)
+			return fd;
+		e = errno;
+		close (fd);
+		if (e != EPROTOTYPE)
+			return -e;
+		if ((fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+			return -errno;
+		if (connect (fd, (struct sockaddr *) &u, sizeof (u)) == 0)
+		{
+			nlog.stream = 1;
+			return fd;
+		}
+		e = errno;
+		close (fd);
+		return -e;
+	}
+	memset (&hints, '\0', sizeof (hints));
+	if (strncasecmp (t, "udp:", 4) == 0)
+		hints.ai_socktype = SOCK_DGRAM;
+	else if (strncasecmp (t, "tcp:", 4) == 0)
+		hints.ai_socktype = SOCK_STREAM;
+	else
+		return -EINVAL;
+	if (strncopy (host, t + 4, sizeof (host)))
+		return -ENAMETOOLONG;
+	if ((port = strrchr (host, ':')) == NULL)
+		return -EINVAL;
+	*port++ = '\0';
+	t = host;
+	if (t[0] == '[' && (e = strlen (t)) > 1 && t[e - 1] == ']')
+	{
+		t[e - 1] = '\0';
+		t++;
+	}
+	if ((e = getaddrinfo (t, port, &hints, &ai)) != 0)
+		return (e == EAI_SYSTEM) ? -errno : -EHOSTUNREACH;
+	e = ECONNREFUSED;
+	for (a = ai; a != NULL; a = a -> ai_next)
+	{
+		if ((fd = socket (a -> ai_family, a -> ai_socktype | SOCK_CLOEXEC, a -> ai_protocol)) == -1)
+		{
+			e = errno;
+			continue;
+		}
+		if (connect (fd, a -> ai_addr, a -> ai_addrlen) == 0)
+			break;
+		e = errno;
+		close (fd);
+		fd = -1;
+	}
+	freeaddrinfo (ai);
+	if (fd == -1)
+		return -e;
+	if (hints.ai_socktype == SOCK_STREAM)
+		nlog.stream = nlog.tcp = 1;
+	return fd;
+}
+
+static void
+_nlog_head (void)
+{
+	struct utsname b;
+	nlog.pid = getpid ();
+	if (uname (&b) != 0)
+		strcpy (b.nodename, "-");
+	snprintf (nlog.head, sizeof (nlog.head), "%.255s %.48s %d ",
+		b.nodename, (nlog.app[0] == '\0' ? "-" : nlog.app), (int) nlog.pid);
+}
+
+/* PROCID changes in the child */
+static void
+_nlog_atfork_child (void)
+{
+	nlog.pid = 0;
+}
+
+gtm_status_t
+posix_netopenlog (int argc, gtm_char_t *target, gtm_char_t *app, gtm_char_t *facility_name)
+{
+	static int atfork = 0;
+	int facility;
+	int fd;
+	check_argc (3);
+	check (get_flags (facility));
+	if (nlog.fd != -1)
+		close (nlog.fd);
+	nlog.fd = -1;
+	if (strncopy (nlog.target, target, sizeof (nlog.target)))
+		return ENAMETOOLONG;
+	if (app[0] == '\0' && log_ident != NULL)
+		app = (gtm_char_t *) log_ident;
+	/* APP-NAME is PRINTUSASCII {1,48} */
+	strncopy (nlog.app, app, 49);
+	nlog.facility = facility;
+	_nlog_head ();
+	if (!atfork && pthread_atfork (NULL, NULL, _nlog_atfork_child) == 0)
+		atfork = 1;
+	if ((fd = _nlog_connect ()) < 0)
+		return -fd;
+	nlog.fd = fd;
+	return 0;
+}
+
+gtm_status_t
+posix_netsyslog (int argc, gtm_char_t *priority_name, gtm_char_t *msgid, gtm_char_t *sd,
+	gtm_char_t *message)
+{
+	struct timespec ts;
+	struct tm tm;
+	char *b = nlog.buf + 16;
+	size_t s = nlog_msg_size - 16;
+	long off;
+	int priority;
+	int l, n, r;
+	int retry;
+	check_argc (4);
+	check (get_param (priority));
+	if (nlog.pid == 0)
+		_nlog_head ();
+	clock_gettime (CLOCK_REALTIME, &ts);
+	_time_cached (ts.tv_sec, &tm, 1);
+	off = tm.tm_gmtoff / 60;
+	l = snprintf (b, s, "<%d>1 %04d-%02d-%02dT%02d:%02d:%02d.%06ld%c%02ld:%02ld %s%.32s %s %s",
+		priority | nlog.facility,
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+		ts.tv_nsec / 1000, (off < 0 ? '-' : '+'), labs (off) / 60, labs (off) % 60,
+		nlog.head, (msgid[0] == '\0' ? "-" : msgid), (sd[0] == '\0' ? "-" : sd), message);
+	if (l < 0)
+		return EINVAL;
+	if ((size_t) l >= s)
+		l = s - 1;
+	if (nlog.tcp)
+	{
+		/* octet counting: "MSG-LEN SP SYSLOG-MSG" */
+		char h[16];
+		n = snprintf (h, sizeof (h), "%d ", l);
+		b -= n;
+		memcpy (b, h, n);
+		l += n;
+	}
+	else if (nlog.stream)
+		l++;
+	for (retry = 0; ; retry++)
+	{
+		if (nlog.fd == -1 && (nlog.fd = _nlog_connect ()) < 0)
+		{
+			r = -nlog.fd;
+			nlog.fd = -1;
+			return r;
+		}
+		clear_errno ();
+		for (n = 0; n < l; n += r)
+			if ((r = send (nlog.fd, b + n, l - n, MSG_NOSIGNAL)) == -1 && errno != EINTR)
+				break;
+			else if (r == -1)
+				r = 0;
+		if (n >= l)
+			return 0;
+		r = errno;
+		/* peer restarted, reconnect once, partial stream writes cannot be resumed */
+		close (nlog.fd);
+		nlog.fd = -1;
+		if (retry || (n > 0) || (r != ECONNREFUSED && r != ENOTCONN && r != EPIPE && r != ECONNRESET))
+			return r;
+	}
+}
+
+void
+posix_netcloselog (int argc UNUSED)
+{
+	if (nlog.fd != -1)
+		close (nlog.fd);
+	nlog.fd = -1;
+}
+
+gtm_ulong_t
+posix_umask (int argc, gtm_ulong_t mask)
+{
 	check_argc (1);
 	return umask (mask);
 }
@@ -590,6 +2680,188 @@ posix_lstat (int argc,
 		st_size, st_blksize, st_blocks, atime, mtime, ctime, 1);
 }
 
+/*
+ * stat in a single "|" joined record, fields in the order of stat:
+ * dev|ino|mode|nlink|uid|gid|rdev|size|blksize|blocks|atime|mtime|ctime
+ */
+gtm_int_t
+posix_stats (int argc, gtm_char_t *path, gtm_int_t nofollow, gtm_char_t *record /* [256] */)
+{
+	struct stat b;
+	check_argc (3);
+	record[0] = '\0';
+	clear_errno ();
+	if ((nofollow ? lstat (path, &b) : stat (path, &b)) == 0)
+		snprintf (record, 256, "%lu|%lu|%lu|%lu|%lu|%lu|%lu|%lld|%lu|%lld|%lld|%lld|%lld",
+			(unsigned long) b.st_dev, (unsigned long) b.st_ino, (unsigned long) b.st_mode,
+			(unsigned long) b.st_nlink, (unsigned long) b.st_uid, (unsigned long) b.st_gid,
+			(unsigned long) b.st_rdev, (long long) b.st_size, (unsigned long) b.st_blksize,
+			(long long) b.st_blocks, (long long) b.st_atime, (long long) b.st_mtime,
+			(long long) b.st_ctime);
+	return errno;
+}
+
+/* 1 when path exists (symbolic links are followed), 0 otherwise */
+gtm_int_t
+posix_exists (int argc, gtm_char_t *path)
+{
+	check_argc (1);
+	return faccessat (AT_FDCWD, path, F_OK, AT_EACCESS) == 0;
+}
+
+/*
+ * statx(2) with a field mask, the result is a "|" joined record of
+ * dev|ino|mode|nlink|uid|gid|rdev|size|blksize|blocks|atime|mtime|ctime|btime
+ * where the fields not requested (or not supported by the filesystem, like
+ * btime often) are empty. Times are "seconds.nanoseconds".
+ */
+
+#define statx_record_size 512
+
+/* fstatat(2) for the kernels (before 4.11) and libcs without statx(2), btime is never set */
+static int
+_statx_stat (const char *path, int flags, struct statx *b)
+{
+	struct stat s;
+	if (fstatat (AT_FDCWD, path, &s, flags) == -1)
+		return -1;
+	memset (b, 0, sizeof (*b));
+	b -> stx_mask = STATX_BASIC_STATS;
+	b -> stx_dev_major = major (s.st_dev);
+	b -> stx_dev_minor = minor (s.st_dev);
+	b -> stx_ino = s.st_ino;
+	b -> stx_mode = s.st_mode;
+	b -> stx_nlink = s.st_nlink;
+	b -> stx_uid = s.st_uid;
+	b -> stx_gid = s.st_gid;
+	b -> stx_rdev_major = major (s.st_rdev);
+	b -> stx_rdev_minor = minor (s.st_rdev);
+	b -> stx_size = s.st_size;
+	b -> stx_blksize = s.st_blksize;
+	b -> stx_blocks = s.st_blocks;
+	b -> stx_atime.tv_sec = s.st_atim.tv_sec;
+	b -> stx_atime.tv_nsec = s.st_atim.tv_nsec;
+	b -> stx_mtime.tv_sec = s.st_mtim.tv_sec;
+	b -> stx_mtime.tv_nsec = s.st_mtim.tv_nsec;
+	b -> stx_ctime.tv_sec = s.st_ctim.tv_sec;
+	b -> stx_ctime.tv_nsec = s.st_ctim.tv_nsec;
+	return 0;
+}
+
+static int
+_statx (const char *path, int statx_mask, char *o /* [statx_record_size] */)
+{
+	int flags = AT_NO_AUTOMOUNT | ((statx_mask & statx_nofollow) ? AT_SYMLINK_NOFOLLOW : 0);
+	struct statx b;
+	unsigned int m;
+	int l;
+	clear_errno ();
+	/* the system call, glibc has the statx() wrapper only since 2.28 */
+#ifdef SYS_statx
+	if (syscall (SYS_statx, AT_FDCWD, path, flags, statx_mask & ~statx_nofollow, &b) == -1 &&
+		(errno != ENOSYS || _statx_stat (path, flags, &b) == -1))
+#else
+	if (_statx_stat (path, flags, &b) == -1)
+#endif
+	{
+		o[0] = '\0';
+		return errno;
+	}
+	m = b.stx_mask & statx_mask;
+	l = snprintf (o, statx_record_size, "%llu|", (unsigned long long) makedev (b.stx_dev_major, b.stx_dev_minor));
+#define statx_field(f, fmt, v) \
+	l += (m & (f)) ? snprintf (o + l, statx_record_size - l, fmt "|", v) : snprintf (o + l, statx_record_size - l, "|")
+#define statx_time(f, t) \
+	l += (m & (f)) ? snprintf (o + l, statx_record_size - l, "%lld.%09u|", (long long) t.tv_sec, t.tv_nsec) : snprintf (o + l, statx_record_size - l, "|")
+	statx_field (STATX_INO, "%llu", (unsigned long long) b.stx_ino);
+	statx_field (STATX_MODE | STATX_TYPE, "%u", (unsigned int) b.stx_mode);
+	statx_field (STATX_NLINK, "%u", b.stx_nlink);
+	statx_field (STATX_UID, "%u", b.stx_uid);
+	statx_field (STATX_GID, "%u", b.stx_gid);
+	l += snprintf (o + l, statx_record_size - l, "%llu|", (unsigned long long) makedev (b.stx_rdev_major, b.stx_rdev_minor));
+	statx_field (STATX_SIZE, "%llu", (unsigned long long) b.stx_size);
+	l += snprintf (o + l, statx_record_size - l, "%u|", b.stx_blksize);
+	statx_field (STATX_BLOCKS, "%llu", (unsigned long long) b.stx_blocks);
+	statx_time (STATX_ATIME, b.stx_atime);
+	statx_time (STATX_MTIME, b.stx_mtime);
+	statx_time (STATX_CTIME, b.stx_ctime);
+#undef statx_field
+#undef statx_time
+	if (m & STATX_BTIME)
+		snprintf (o + l, statx_record_size - l, "%lld.%09u", (long long) b.stx_btime.tv_sec, b.stx_btime.tv_nsec);
+	return 0;
+}
+
+gtm_int_t
+posix_statx (int argc, gtm_char_t *path, gtm_char_t *statx_mask_name, gtm_char_t *record /* [512] */)
+{
+	int statx_mask;
+	check_argc (3);
+	record[0] = '\0';
+	check (get_flags (statx_mask));
+	if ((statx_mask & ~statx_nofollow) == 0)
+		statx_mask |= STATX_BASIC_STATS | STATX_BTIME;
+	return _statx (path, statx_mask, record);
+}
+
+/*
+ * Stats the line_delimiter joined paths, the results are line_delimiter
+ * joined "errno|" prefixed statx_mask records, in the same order. consumed is
+ * set to the number of bytes of paths processed, less than the length of
+ * paths when the output is full.
+ */
+gtm_status_t
+posix_statmany (int argc, gtm_char_t *paths, gtm_char_t *statx_mask_name, gtm_int_t *consumed,
+	gtm_char_t *out /* [1048576] */)
+{
+	char path[4096];
+	char r[statx_record_size];
+	char b[statx_record_size + 16];
+	ssize_t s = 1048576;
+	char *p = out;
+	char *q = paths;
+	char *e;
+	size_t l;
+	int statx_mask;
+	int n = 0;
+	check_argc (4);
+	out[0] = '\0';
+	*consumed = 0;
+	check (get_flags (statx_mask));
+	if ((statx_mask & ~statx_nofollow) == 0)
+		statx_mask |= STATX_BASIC_STATS | STATX_BTIME;
+	for (;;)
+	{
+		if ((e = strchr (q, line_delimiter[0])) == NULL)
+			e = q + strlen (q);
+		if ((l = e - q) >= sizeof (path))
+			return ENAMETOOLONG;
+		memcpy (path, q, l);
+		path[l] = '\0';
+		l = snprintf (b, sizeof (b), "%d|%s", _statx (path, statx_mask, r), r);
+		if ((ssize_t) l + (n > 0) >= s)
+		{
+			if (n == 0)
+				return ERANGE;
+			break;
+		}
+		if (n++ > 0)
+		{
+			*p++ = line_delimiter[0];
+			s--;
+		}
+		memcpy (p, b, l + 1);
+		p += l;
+		s -= l;
+		q = e;
+		if (*q == '\0')
+			break;
+		q++;
+	}
+	*consumed = q - paths;
+	return 0;
+}
+
 gtm_status_t
 posix_readlink (int argc, gtm_char_t* path, gtm_char_t* name /* [1024] */)
 {
@@ -601,6 +2873,30 @@ posix_readlink (int argc, gtm_char_t* path, gtm_char_t* name /* [1024] */)
 	return errno;
 }
 
+gtm_status_t
+posix_readlinkx (int argc, gtm_char_t *path, gtm_long_t *len)
+{
+	size_t n = result.size > 4096 ? result.size : 4096;
+	ssize_t s;
+	check_argc (2);
+	*len = 0;
+	result.len = 0;
+	for (;;)
+	{
+		if (_result_reserve (n) != 0)
+			return ENOMEM;
+		if ((s = readlink (path, result.p, result.size)) == -1)
+			return errno;
+		/* possibly truncated, the arena grows only for a longer target */
+		if ((size_t) s < result.size)
+			break;
+		n = result.size * 2;
+	}
+	result.p[s] = '\0';
+	result.len = *len = s;
+	return 0;
+}
+
 static gtm_status_t
 _posix_link (int argc, gtm_char_t *oldpath, gtm_char_t *newpath, int sym)
 {
@@ -611,280 +2907,3434 @@ _posix_link (int argc, gtm_char_t *oldpath, gtm_char_t *newpath, int sym)
 }
 
 gtm_status_t
-posix_link (int argc, gtm_char_t *oldpath, gtm_char_t *newpath)
+posix_link (int argc, gtm_char_t *oldpath, gtm_char_t *newpath)
+{
+	return _posix_link (argc, oldpath, newpath, 0);
+}
+
+gtm_status_t
+posix_symlink (int argc, gtm_char_t *oldpath, gtm_char_t *newpath)
+{
+	return _posix_link (argc, oldpath, newpath, 1);
+}
+
+gtm_status_t
+posix_unlink (int argc, gtm_char_t *path)
+{
+	check_argc (1);
+	clear_errno ();
+	unlink (path);
+	return errno;
+}
+
+gtm_status_t
+posix_mkdir (int argc, gtm_char_t *path, gtm_ulong_t mode)
+{
+	check_argc (2);
+	clear_errno ();
+	mkdir (path, mode);
+	return errno;
+}
+
+gtm_status_t
+posix_rmdir (int argc, gtm_char_t *path)
+{
+	check_argc (1);
+	clear_errno ();
+	rmdir (path);
+	return errno;
+}
+
+gtm_status_t
+posix_chmod (int argc, gtm_char_t *path, gtm_ulong_t mode)
+{
+	check_argc (2);
+	clear_errno ();
+	chmod (path, mode);
+	return errno;
+}
+
+static gtm_status_t
+_posix_chown (int argc, gtm_char_t *path, gtm_ulong_t uid, gtm_ulong_t gid, int l)
+{
+	check_argc (3);
+	clear_errno ();
+	l ? lchown (path, uid, gid) : chown (path, uid, gid);
+	return errno;
+}
+
+gtm_status_t
+posix_chown (int argc, gtm_char_t *path, gtm_ulong_t uid, gtm_ulong_t gid)
+{
+	return _posix_chown (argc, path, uid, gid, 0);
+}
+
+gtm_status_t
+posix_lchown (int argc, gtm_char_t *path, gtm_ulong_t uid, gtm_ulong_t gid)
+{
+	return _posix_chown (argc, path, uid, gid, 1);
+}
+
+/*
+ * File descriptors, kept in the handle table, so a stale handle can not
+ * hit a descriptor reused by GT.M itself. pread and pwrite take explicit
+ * 0 based offsets and do not move the file offset, so several processes
+ * (or handles) can write the same file concurrently.
+ */
+
+typedef struct
+{
+	int fd;
+}
+fdesc;
+
+static fdesc *
+_fd_get (gtm_ulong_t h)
+{
+	return handle_get (h, handle_fd);
+}
+
+gtm_status_t
+posix_fd_open (int argc, gtm_char_t *path, gtm_char_t *open_flags_name, gtm_ulong_t mode, gtm_ulong_t *h)
+{
+	int open_flags;
+	fdesc *f;
+	int e;
+	check_argc (4);
+	*h = 0;
+	check (get_flags (open_flags));
+	if ((f = malloc (sizeof (fdesc))) == NULL)
+		return ENOMEM;
+	clear_errno ();
+	if ((f -> fd = open (path, open_flags | O_CLOEXEC, (mode_t) mode)) == -1)
+	{
+		e = errno;
+		free (f);
+		return e;
+	}
+	if ((e = handle_new (handle_fd, f, h)) != 0)
+	{
+		close (f -> fd);
+		free (f);
+	}
+	return e;
+}
+
+gtm_status_t
+posix_fd_pread (int argc, gtm_ulong_t h, gtm_long_t offset, gtm_long_t len, gtm_string_t *s /* [1048576] */)
+{
+	fdesc *f;
+	ssize_t r;
+	check_argc (4);
+	s -> length = 0;
+	if ((f = _fd_get (h)) == NULL || offset < 0 || len < 0)
+		return EINVAL;
+	if (len > 1048576)
+		len = 1048576;
+	/* short reads are retried, only the end of file ends the loop early */
+	while (s -> length < len)
+	{
+		if ((r = pread (f -> fd, s -> address + s -> length, len - s -> length, offset + s -> length)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		if (r == 0)
+			break;
+		s -> length += r;
+	}
+	return 0;
+}
+
+/* pwrite(2) retried until all written, returns errno */
+static int
+_write_all (int fd, const char *p, size_t len, off_t offset)
+{
+	size_t n = 0;
+	ssize_t r;
+	while (n < len)
+	{
+		if ((r = pwrite (fd, p + n, len - n, offset + n)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		n += r;
+	}
+	return 0;
+}
+
+gtm_status_t
+posix_fd_pwrite (int argc, gtm_ulong_t h, gtm_long_t offset, gtm_string_t *s)
+{
+	fdesc *f;
+	check_argc (3);
+	if ((f = _fd_get (h)) == NULL || offset < 0)
+		return EINVAL;
+	return _write_all (f -> fd, s -> address, s -> length, offset);
+}
+
+static gtm_status_t
+_fd_sync (int argc, gtm_ulong_t h, int data)
+{
+	fdesc *f;
+	check_argc (1);
+	if ((f = _fd_get (h)) == NULL)
+		return EINVAL;
+	clear_errno ();
+	data ? fdatasync (f -> fd) : fsync (f -> fd);
+	return errno;
+}
+
+gtm_status_t
+posix_fd_fsync (int argc, gtm_ulong_t h)
+{
+	return _fd_sync (argc, h, 0);
+}
+
+gtm_status_t
+posix_fd_fdatasync (int argc, gtm_ulong_t h)
+{
+	return _fd_sync (argc, h, 1);
+}
+
+/* posix_fallocate(3) and posix_fadvise(3) return the error instead of setting errno */
+gtm_status_t
+posix_fd_fallocate (int argc, gtm_ulong_t h, gtm_long_t offset, gtm_long_t len)
+{
+	fdesc *f;
+	check_argc (3);
+	if ((f = _fd_get (h)) == NULL)
+		return EINVAL;
+	return posix_fallocate (f -> fd, offset, len);
+}
+
+gtm_status_t
+posix_fd_fadvise (int argc, gtm_ulong_t h, gtm_long_t offset, gtm_long_t len, gtm_char_t *advice_name)
+{
+	fdesc *f;
+	int advice;
+	check_argc (4);
+	check (get_param (advice));
+	if ((f = _fd_get (h)) == NULL)
+		return EINVAL;
+	return posix_fadvise (f -> fd, offset, len, advice);
+}
+
+gtm_status_t
+posix_fd_close (int argc, gtm_ulong_t h)
+{
+	fdesc *f;
+	int e = 0;
+	check_argc (1);
+	if ((f = handle_del (h, handle_fd)) == NULL)
+		return EINVAL;
+	/* the descriptor is released even if close(2) fails, see close(2) NOTES */
+	if (close (f -> fd) == -1 && errno != EINTR)
+		e = errno;
+	free (f);
+	return e;
+}
+
+/* read(2) for pipes and other streams, returns what is available up to len,
+   eof: 1 at the end of file, "" with eof 0 when nothing is available on non-blocking fd */
+gtm_status_t
+posix_fd_read (int argc, gtm_ulong_t h, gtm_long_t len, gtm_string_t *s /* [1048576] */, gtm_int_t *eof)
+{
+	fdesc *f;
+	ssize_t r;
+	check_argc (4);
+	s -> length = 0;
+	*eof = 0;
+	if ((f = _fd_get (h)) == NULL || len < 0)
+		return EINVAL;
+	if (len > 1048576)
+		len = 1048576;
+	while ((r = read (f -> fd, s -> address, len)) == -1)
+		if (errno == EAGAIN)
+			return 0;
+		else if (errno != EINTR)
+			return errno;
+	s -> length = r;
+	*eof = (r == 0 && len > 0);
+	return 0;
+}
+
+/* write(2) for pipes and other streams, written: bytes written, less than length of s on non-blocking fd */
+gtm_status_t
+posix_fd_write (int argc, gtm_ulong_t h, gtm_string_t *s, gtm_long_t *written)
+{
+	fdesc *f;
+	ssize_t r;
+	check_argc (3);
+	*written = 0;
+	if ((f = _fd_get (h)) == NULL)
+		return EINVAL;
+	while ((size_t) *written < s -> length)
+	{
+		if ((r = write (f -> fd, s -> address + *written, s -> length - *written)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			/* full or partial write on non-blocking fd is not an error, written tells */
+			if (errno == EAGAIN)
+				break;
+			return errno;
+		}
+		*written += r;
+	}
+	return 0;
+}
+
+/* wraps fd in a new fd handle, closes fd on failure */
+static int
+_fd_handle (int fd, gtm_ulong_t *h)
+{
+	fdesc *f;
+	int e;
+	*h = 0;
+	if ((f = malloc (sizeof (fdesc))) == NULL)
+	{
+		close (fd);
+		return ENOMEM;
+	}
+	f -> fd = fd;
+	if ((e = handle_new (handle_fd, f, h)) != 0)
+	{
+		close (fd);
+		free (f);
+	}
+	return e;
+}
+
+/*
+ * Copies the data from in to out, trying the cheapest method first: reflink
+ * (shares the extents on btrfs, XFS, ...), copy_file_range(2) (in-kernel,
+ * possibly server side on NFS), sendfile(2) and finally a read/write loop
+ * with a large buffer. Each fallback continues from the offset reached.
+ */
+static mode_t
+_umask (void)
+{
+	mode_t m = umask (0);
+	umask (m);
+	return m;
+}
+
+static int
+_copy_data (int in, int out, off_t size)
+{
+	off_t off = 0;
+	ssize_t r;
+	char *b;
+#ifdef FICLONE
+	if (ioctl (out, FICLONE, in) == 0)
+		return 0;
+#endif
+#ifdef SYS_copy_file_range
+	while (off < size)
+	{
+		/* the raw syscall, glibc < 2.27 lacks the wrapper */
+		if ((r = syscall (SYS_copy_file_range, in, &off, out, NULL, (size_t) (size - off), 0)) > 0)
+			continue;
+		if (r == 0)
+			break;
+		if (errno == EINTR)
+			continue;
+		if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP && errno != EBADF)
+			return errno;
+		break;
+	}
+	if (off >= size && size > 0)
+		return 0;
+#endif
+	while (off < size)
+	{
+		if ((r = sendfile (out, in, &off, (size_t) (size - off))) > 0)
+			continue;
+		if (r == 0)
+			break;
+		if (errno == EINTR)
+			continue;
+		if (errno != ENOSYS && errno != EINVAL)
+			return errno;
+		break;
+	}
+	/* zero sized files like those in /proc may still have data */
+	if (off >= size && size > 0)
+		return 0;
+	if ((b = malloc (1 << 20)) == NULL)
+		return ENOMEM;
+	/* the size is only a hint here, files growing or shrinking are copied up to the end */
+	for (;;)
+	{
+		if ((r = pread (in, b, 1 << 20, off)) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (r == 0 || _write_all (out, b, r, off) != 0)
+			break;
+		off += r;
+	}
+	r = (r == 0) ? 0 : errno;
+	free (b);
+	return r;
+}
+
+gtm_status_t
+posix_copyfile (int argc, gtm_char_t *src, gtm_char_t *dst, gtm_char_t *copy_name)
+{
+	char tmp[4096];
+	struct stat st, dt;
+	int copy;
+	int in, out;
+	int e;
+	char *p;
+	check_argc (3);
+	check (get_flags (copy));
+	clear_errno ();
+	if ((in = open (src, O_RDONLY | O_CLOEXEC)) == -1)
+		return errno;
+	if (fstat (in, &st) == -1)
+	{
+		e = errno;
+		close (in);
+		return e;
+	}
+	/* like cp(1), copying a file onto itself (or its hard link) is refused */
+	if ((copy & copy_atomic) && stat (dst, &dt) == 0 && dt.st_dev == st.st_dev && dt.st_ino == st.st_ino)
+	{
+		close (in);
+		return EINVAL;
+	}
+	if (copy & copy_atomic)
+	{
+		/* a hidden temporary file next to dst, renamed into place once complete */
+		p = strrchr (dst, '/');
+		if (snprintf (tmp, sizeof (tmp), "%.*s.%s.XXXXXX", (p == NULL ? 0 : (int) (p - dst + 1)), dst,
+			(p == NULL ? dst : p + 1)) >= (int) sizeof (tmp))
+		{
+			close (in);
+			return ENAMETOOLONG;
+		}
+		if ((out = mkostemp (tmp, O_CLOEXEC)) != -1)
+			fchmod (out, st.st_mode & 0777 & ~_umask ());
+	}
+	/* truncated only after the check for the same file */
+	else if ((out = open (dst, O_WRONLY | O_CREAT | O_CLOEXEC | ((copy & copy_excl) ? O_EXCL : 0),
+		st.st_mode & 0777)) != -1)
+	{
+		if (fstat (out, &dt) == 0 && dt.st_dev == st.st_dev && dt.st_ino == st.st_ino)
+			errno = EINVAL;
+		else if (ftruncate (out, 0) == 0)
+			errno = 0;
+		if (errno != 0)
+		{
+			e = errno;
+			close (out);
+			close (in);
+			return e;
+		}
+	}
+	if (out == -1)
+	{
+		e = errno;
+		close (in);
+		return e;
+	}
+	e = _copy_data (in, out, st.st_size);
+	if (e == 0 && (copy & copy_owner) && fchown (out, st.st_uid, st.st_gid) == -1 && errno != EPERM)
+		e = errno;
+	/* after fchown(2), which may clear the set-user-ID and set-group-ID bits */
+	if (e == 0 && (copy & copy_mode) && fchmod (out, st.st_mode & 07777) == -1)
+		e = errno;
+	if (e == 0 && (copy & copy_times))
+	{
+		struct timespec t[2] = { st.st_atim, st.st_mtim };
+		if (futimens (out, t) == -1)
+			e = errno;
+	}
+	if (close (out) == -1 && e == 0 && errno != EINTR)
+		e = errno;
+	close (in);
+	if (copy & copy_atomic)
+	{
+		/* link(2) fails with EEXIST, rename(2) would replace dst */
+		if (e == 0 && ((copy & copy_excl) ? link (tmp, dst) : rename (tmp, dst)) == -1)
+			e = errno;
+		if (e != 0 || (copy & copy_excl))
+			unlink (tmp);
+	}
+	return e;
+}
+
+/*
+ * Passwd and group lookups, through the reentrant NSS functions, optionally
+ * cached in process (with group lists of users) for a TTL set with nsscache,
+ * since NSS backed by LDAP can take tens of milliseconds for a lookup (or
+ * a miss, which is cached with its own TTL). The cache is a fixed size hash
+ * table, flushed as a whole when it reaches nss_cache_limit entries.
+ */
+
+#define nss_buckets 1024
+#define nss_cache_limit 8192
+
+enum
+{
+	nss_pwnam,
+	nss_pwuid,
+	nss_grnam,
+	nss_grgid,
+	nss_grouplist
+};
+
+typedef struct nss_entry
+{
+	struct nss_entry *next;
+	int kind;
+	unsigned long id;
+	time_t expires;
+	int error;
+	gtm_ulong_t uid;
+	gtm_ulong_t gid;
+	/* pw: name, passwd, gecos, dir, shell, gr: name, passwd, members */
+	char *f[5];
+	char key[];
+}
+nss_entry;
+
+static struct
+{
+	nss_entry *bucket[nss_buckets];
+	unsigned int n;
+	int ttl;
+	int negative_ttl;
+}
+nss_cache;
+
+static unsigned int
+_nss_hash (int kind, const char *name, unsigned long id)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u ^ kind;
+	if (name != NULL)
+		for (; *name; name++)
+			h = (h ^ (unsigned char) *name) * 16777619u;
+	else
+		h = (h ^ id) * 16777619u;
+	return h & (nss_buckets - 1);
+}
+
+static time_t
+_nss_now (void)
+{
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC_COARSE, &t);
+	return t.tv_sec;
+}
+
+static void
+_nss_flush (void)
+{
+	nss_entry *e, *n;
+	int i;
+	for (i = 0; i < nss_buckets; i++)
+	{
+		for (e = nss_cache.bucket[i]; e != NULL; e = n)
+		{
+			n = e -> next;
+			free (e);
+		}
+		nss_cache.bucket[i] = NULL;
+	}
+	nss_cache.n = 0;
+}
+
+/* copies the strings into a single allocated entry */
+static nss_entry *
+_nss_entry (int kind, const char *name, unsigned long id, int error, char **f, int n)
+{
+	size_t l = (name != NULL) ? strlen (name) + 1 : 1;
+	size_t s[5];
+	nss_entry *e;
+	char *p;
+	int i;
+	for (i = 0; i < n; i++)
+		l += (s[i] = strlen (f[i]) + 1);
+	if ((e = malloc (sizeof (nss_entry) + l)) == NULL)
+		return NULL;
+	e -> next = NULL;
+	e -> kind = kind;
+	e -> id = id;
+	e -> error = error;
+	strcpy (e -> key, (name != NULL) ? name : "");
+	p = e -> key + strlen (e -> key) + 1;
+	for (i = 0; i < n; i++)
+	{
+		e -> f[i] = memcpy (p, f[i], s[i]);
+		p += s[i];
+	}
+	return e;
+}
+
+/* calls the reentrant lookup, growing the buffer while it returns ERANGE */
+static int
+_nss_fetch (int kind, const char *name, unsigned long id, nss_entry **r)
+{
+	struct passwd pw, *pwp = NULL;
+	struct group gr, *grp = NULL;
+	char *f[5] = { "", "", "", "", "" };
+	char *mem = NULL;
+	char *b = NULL, *t;
+	size_t s = 4096;
+	size_t l;
+	int e, n, i;
+	*r = NULL;
+	for (;;)
+	{
+		if ((t = realloc (b, s)) == NULL)
+		{
+			free (b);
+			return ENOMEM;
+		}
+		b = t;
+		switch (kind)
+		{
+			case nss_pwnam:
+				e = getpwnam_r (name, &pw, b, s, &pwp);
+				break;
+			case nss_pwuid:
+				e = getpwuid_r (id, &pw, b, s, &pwp);
+				break;
+			case nss_grnam:
+				e = getgrnam_r (name, &gr, b, s, &grp);
+				break;
+			default:
+				e = getgrgid_r (id, &gr, b, s, &grp);
+				break;
+		}
+		if (e != ERANGE || s >= (1 << 24))
+			break;
+		s *= 2;
+	}
+	/* not found is reported inconsistently, see getpwnam(3) */
+	if (pwp == NULL && grp == NULL && (e == 0 || e == ESRCH || e == EBADF || e == EPERM))
+		e = ENOENT;
+	if (e == 0)
+	{
+		if (pwp != NULL)
+		{
+			f[0] = pw.pw_name;
+			f[1] = pw.pw_passwd;
+			f[2] = pw.pw_gecos;
+			f[3] = pw.pw_dir;
+			f[4] = pw.pw_shell;
+			n = 5;
+		}
+		else
+		{
+			for (l = 1, i = 0; gr.gr_mem[i] != NULL; i++)
+				l += strlen (gr.gr_mem[i]) + 1;
+			if ((mem = malloc (l)) == NULL)
+			{
+				free (b);
+				return ENOMEM;
+			}
+			for (mem[0] = '\0', i = 0; gr.gr_mem[i] != NULL; i++)
+			{
+				if (i > 0)
+					strcat (mem, list_delimiter);
+				strcat (mem, gr.gr_mem[i]);
+			}
+			f[0] = gr.gr_name;
+			f[1] = gr.gr_passwd;
+			f[2] = mem;
+			n = 3;
+		}
+	}
+	else
+		n = 0;
+	if (e == 0 || e == ENOENT)
+	{
+		if ((*r = _nss_entry (kind, name, id, e, f, n)) == NULL)
+			e = ENOMEM;
+		else if (e == 0)
+		{
+			(*r) -> uid = (pwp != NULL) ? pw.pw_uid : 0;
+			(*r) -> gid = (pwp != NULL) ? pw.pw_gid : gr.gr_gid;
+		}
+	}
+	free (mem);
+	free (b);
+	return e;
+}
+
+static int _nss_fetch_groups (const char *name, nss_entry **r);
+
+/*
+ * Returns the entry, from the cache when enabled, *tmp is set when the
+ * entry is not cached and must be freed by the caller.
+ */
+static int
+_nss_get (int kind, const char *name, unsigned long id, nss_entry **r, int *tmp)
+{
+	unsigned int h = _nss_hash (kind, name, id);
+	nss_entry **p, *e;
+	time_t now = 0;
+	int error;
+	*tmp = 0;
+	if (nss_cache.ttl > 0 || nss_cache.negative_ttl > 0)
+	{
+		now = _nss_now ();
+		for (p = &nss_cache.bucket[h]; (e = *p) != NULL; p = &e -> next)
+			if (e -> kind == kind && (name != NULL ? strcmp (e -> key, name) == 0 : e -> id == id))
+			{
+				if (e -> expires > now)
+				{
+					*r = e;
+					return e -> error;
+				}
+				*p = e -> next;
+				free (e);
+				nss_cache.n--;
+				break;
+			}
+	}
+	error = (kind == nss_grouplist) ? _nss_fetch_groups (name, r) : _nss_fetch (kind, name, id, r);
+	if (*r == NULL)
+		return error;
+	if ((error == 0 && nss_cache.ttl > 0) || (error == ENOENT && nss_cache.negative_ttl > 0))
+	{
+		if (nss_cache.n >= nss_cache_limit)
+			_nss_flush ();
+		(*r) -> expires = now + (error ? nss_cache.negative_ttl : nss_cache.ttl);
+		(*r) -> next = nss_cache.bucket[h];
+		nss_cache.bucket[h] = *r;
+		nss_cache.n++;
+	}
+	else
+		*tmp = 1;
+	return error;
+}
+
+/* ttl and negative_ttl in seconds, 0 disables caching (the default) */
+gtm_status_t
+posix_nsscache (int argc, gtm_int_t ttl, gtm_int_t negative_ttl)
+{
+	check_argc (2);
+	if (ttl < 0 || negative_ttl < 0)
+		return EINVAL;
+	nss_cache.ttl = ttl;
+	nss_cache.negative_ttl = negative_ttl;
+	_nss_flush ();
+	return 0;
+}
+
+void
+posix_nssflush (int argc UNUSED)
+{
+	_nss_flush ();
+}
+
+static gtm_status_t
+_posix_getpw (int argc,
+	gtm_char_t *name,
+	gtm_ulong_t uid,
+	gtm_char_t *pw_name /* [64] */, gtm_char_t *pw_passwd /* [64] */,
+	gtm_ulong_t *pw_uid, gtm_ulong_t *pw_gid,
+	gtm_char_t *pw_gecos /* [256] */, gtm_char_t *pw_dir /* [1024] */, gtm_char_t *pw_shell /* [1024] */)
+{
+	nss_entry *b;
+	int tmp;
+	int e;
+	check_argc (8);
+	*pw_uid = 0;
+	*pw_gid = 0;
+	pw_name[0] = '\0';
+	pw_passwd[0] = '\0';
+	pw_gecos[0] = '\0';
+	pw_dir[0] = '\0';
+	pw_shell[0] = '\0';
+	if ((e = _nss_get (name == NULL ? nss_pwuid : nss_pwnam, name, uid, &b, &tmp)) == 0)
+	{
+		*pw_uid = b -> uid;
+		*pw_gid = b -> gid;
+		if (strncopy (pw_name, b -> f[0], 64) ||
+			strncopy (pw_passwd, b -> f[1], 64) ||
+			strncopy (pw_gecos, b -> f[2], 256) ||
+			strncopy (pw_dir, b -> f[3], 1024) ||
+			strncopy (pw_shell, b -> f[4], 1024))
+				e = ERANGE;
+	}
+	if (tmp)
+		free (b);
+	return e;
+}
+
+gtm_status_t
+posix_getpwnam (int argc,
+	gtm_char_t *name,
+	gtm_char_t *pw_name /* [64] */, gtm_char_t *pw_passwd /* [64] */,
+	gtm_ulong_t *pw_uid, gtm_ulong_t *pw_gid,
+	gtm_char_t *pw_gecos /* [256] */, gtm_char_t *pw_dir /* [1024] */, gtm_char_t *pw_shell /* [1024] */)
+{
+	return _posix_getpw (argc, name, 0, pw_name, pw_passwd, pw_uid, pw_gid, pw_gecos, pw_dir, pw_shell);
+}
+
+gtm_status_t
+posix_getpwuid (int argc,
+	gtm_ulong_t uid,
+	gtm_char_t *pw_name /* [64] */, gtm_char_t *pw_passwd /* [64] */,
+	gtm_ulong_t *pw_uid, gtm_ulong_t *pw_gid,
+	gtm_char_t *pw_gecos /* [256] */, gtm_char_t *pw_dir /* [1024] */, gtm_char_t *pw_shell /* [1024] */)
+{
+	return _posix_getpw (argc, NULL, uid, pw_name, pw_passwd, pw_uid, pw_gid, pw_gecos, pw_dir, pw_shell);
+}
+
+static gtm_status_t
+_posix_getgr (int argc,
+	gtm_char_t *name,
+	gtm_ulong_t gid,
+	gtm_char_t *gr_name /* [64] */, gtm_char_t *gr_passwd /* [64] */,
+	gtm_ulong_t *gr_gid, gtm_char_t *gr_mem /* [4096] */)
+{
+	nss_entry *g;
+	int tmp;
+	int e;
+	check_argc (5);
+	*gr_gid = 0;
+	gr_name[0] = '\0';
+	gr_passwd[0] = '\0';
+	gr_mem[0] = '\0';
+	if ((e = _nss_get (name == NULL ? nss_grgid : nss_grnam, name, gid, &g, &tmp)) == 0)
+	{
+		*gr_gid = g -> gid;
+		if (strncopy (gr_name, g -> f[0], 64) ||
+			strncopy (gr_passwd, g -> f[1], 64) ||
+			strncopy (gr_mem, g -> f[2], 4096))
+				e = ERANGE;
+	}
+	if (tmp)
+		free (g);
+	return e;
+}
+
+/*
+ * Passwd and group entries as single lines in passwd(5) and group(5)
+ * format, "name:passwd:uid:gid:gecos:dir:shell" and "name:passwd:gid:mem"
+ * with "," joined members, stashed in the result arena.
+ */
+static gtm_status_t
+_posix_getentx (int kind, gtm_char_t *name, gtm_ulong_t id, gtm_long_t *len)
+{
+	nss_entry *b;
+	char n[64];
+	char *p;
+	int tmp;
+	int e;
+	*len = 0;
+	result.len = 0;
+	if ((e = _nss_get (kind, name, id, &b, &tmp)) != 0)
+		return e;
+	if (kind == nss_pwnam || kind == nss_pwuid)
+	{
+		snprintf (n, sizeof (n), ":%lu:%lu:", b -> uid, b -> gid);
+		e = _result_append (b -> f[0], strlen (b -> f[0])) ||
+			_result_append (":", 1) ||
+			_result_append (b -> f[1], strlen (b -> f[1])) ||
+			_result_append (n, strlen (n)) ||
+			_result_append (b -> f[2], strlen (b -> f[2])) ||
+			_result_append (":", 1) ||
+			_result_append (b -> f[3], strlen (b -> f[3])) ||
+			_result_append (":", 1) ||
+			_result_append (b -> f[4], strlen (b -> f[4]));
+	}
+	else
+	{
+		snprintf (n, sizeof (n), ":%lu:", b -> gid);
+		e = _result_append (b -> f[0], strlen (b -> f[0])) ||
+			_result_append (":", 1) ||
+			_result_append (b -> f[1], strlen (b -> f[1])) ||
+			_result_append (n, strlen (n)) ||
+			_result_append (b -> f[2], strlen (b -> f[2]));
+		if (!e)
+			for (p = result.p + result.len - strlen (b -> f[2]); *p; p++)
+				if (*p == list_delimiter[0])
+					*p = ',';
+	}
+	if (tmp)
+		free (b);
+	if (e)
+		return ENOMEM;
+	*len = result.len;
+	return 0;
+}
+
+gtm_status_t
+posix_getpwnamx (int argc, gtm_char_t *name, gtm_long_t *len)
+{
+	check_argc (2);
+	return _posix_getentx (nss_pwnam, name, 0, len);
+}
+
+gtm_status_t
+posix_getpwuidx (int argc, gtm_ulong_t uid, gtm_long_t *len)
+{
+	check_argc (2);
+	return _posix_getentx (nss_pwuid, NULL, uid, len);
+}
+
+gtm_status_t
+posix_getgrnamx (int argc, gtm_char_t *name, gtm_long_t *len)
+{
+	check_argc (2);
+	return _posix_getentx (nss_grnam, name, 0, len);
+}
+
+gtm_status_t
+posix_getgrgidx (int argc, gtm_ulong_t gid, gtm_long_t *len)
+{
+	check_argc (2);
+	return _posix_getentx (nss_grgid, NULL, gid, len);
+}
+
+gtm_status_t
+posix_getgrnam (int argc,
+	gtm_char_t *name,
+	gtm_char_t *gr_name /* [64] */, gtm_char_t *gr_passwd /* [64] */,
+	gtm_ulong_t *gr_gid, gtm_char_t *gr_mem /* [4096] */)
+{
+	return _posix_getgr (argc, name, 0, gr_name, gr_passwd, gr_gid, gr_mem);
+}
+
+gtm_status_t
+posix_getgrgid (int argc,
+	gtm_ulong_t gid,
+	gtm_char_t *gr_name /* [64] */, gtm_char_t *gr_passwd /* [64] */,
+	gtm_ulong_t *gr_gid, gtm_char_t *gr_mem /* [4096] */)
+{
+	return _posix_getgr (argc, NULL, gid, gr_name, gr_passwd, gr_gid, gr_mem);
+}
+
+/*
+ * BSD getgrouplist like function (non-POSIX), "|" joined names of the
+ * groups of the user, including the primary group, through getgrouplist(3),
+ * which uses the initgroups NSS backends (indexed in sssd and LDAP) instead
+ * of enumerating all the groups.
+ */
+static int
+_nss_fetch_groups (const char *name, nss_entry **r)
+{
+	nss_entry *pw, *gr;
+	gid_t *g = NULL, *t;
+	gid_t base;
+	int n = 64;
+	int i, e, tmp;
+	size_t l = 0, s = 65536;
+	char *list, *p;
+	*r = NULL;
+	/* the primary group is passed explicitly, an unknown user has none */
+	if ((e = _nss_get (nss_pwnam, name, 0, &pw, &tmp)) != 0 && e != ENOENT)
+		return e;
+	base = (e == 0) ? pw -> gid : (gid_t) -1;
+	if (tmp)
+		free (pw);
+	for (;;)
+	{
+		if ((t = realloc (g, n * sizeof (gid_t))) == NULL)
+		{
+			free (g);
+			return ENOMEM;
+		}
+		g = t;
+		i = n;
+		if (getgrouplist (name, base, g, &i) != -1)
+			break;
+		/* glibc sets the required size, others do not */
+		n = (i > n) ? i : n * 2;
+	}
+	n = i;
+	if ((list = malloc (s)) == NULL)
+	{
+		free (g);
+		return ENOMEM;
+	}
+	list[0] = '\0';
+	for (i = 0; i < n; i++)
+	{
+		char id[32];
+		const char *gn = id;
+		if (g[i] == (gid_t) -1 && base == (gid_t) -1)
+			continue;
+		e = _nss_get (nss_grgid, NULL, g[i], &gr, &tmp);
+		if (e == 0)
+			gn = gr -> f[0];
+		else
+			snprintf (id, sizeof (id), "%lu", (unsigned long) g[i]);
+		if (l + strlen (gn) + 2 > s)
+		{
+			if (tmp)
+				free (gr);
+			free (list);
+			free (g);
+			return ERANGE;
+		}
+		l += sprintf (list + l, "%s%s", (l ? list_delimiter : ""), gn);
+		if (tmp)
+			free (gr);
+	}
+	free (g);
+	p = list;
+	*r = _nss_entry (nss_grouplist, name, 0, 0, &p, 1);
+	free (list);
+	return (*r == NULL) ? ENOMEM : 0;
+}
+
+gtm_status_t
+posix_getgrouplist (int argc, gtm_char_t *name, gtm_char_t *list /* [65536] */)
+{
+	nss_entry *b;
+	int tmp;
+	int e;
+	check_argc (2);
+	list[0] = '\0';
+	if ((e = _nss_get (nss_grouplist, name, 0, &b, &tmp)) == 0 && strncopy (list, b -> f[0], 65536))
+		e = ERANGE;
+	if (tmp)
+		free (b);
+	return e;
+}
+
+gtm_status_t
+posix_getgrouplistx (int argc, gtm_char_t *name, gtm_long_t *len)
+{
+	nss_entry *b;
+	int tmp;
+	int e;
+	check_argc (2);
+	*len = 0;
+	result.len = 0;
+	if ((e = _nss_get (nss_grouplist, name, 0, &b, &tmp)) == 0)
+		e = _result_set (b -> f[0], len);
+	if (tmp)
+		free (b);
+	return e;
+}
+
+gtm_status_t
+posix_opendir (int argc, gtm_char_t *path, gtm_ulong_t *dir)
+{
+	DIR *b;
+	int e;
+	check_argc (2);
+	*dir = 0;
+	clear_errno ();
+	if ((b = opendir (path)) != NULL)
+		if ((e = handle_new (handle_dir, b, dir)) != 0)
+		{
+			closedir (b);
+			return e;
+		}
+	return errno;
+}
+
+gtm_status_t
+posix_readdir (int argc, gtm_ulong_t dir, gtm_char_t *name /* [256] */)
+{
+	struct dirent *b;
+	DIR *d;
+	check_argc (2);
+	name[0] = '\0';
+	if ((d = handle_get (dir, handle_dir)) == NULL)
+		return EINVAL;
+	clear_errno ();
+	if ((b = readdir (d)) != NULL)
+		if (strncopy (name, b -> d_name, 256))
+			return ERANGE;
+	return errno;
+}
+
+gtm_status_t
+posix_closedir (int argc, gtm_ulong_t dir)
+{
+	DIR *d;
+	check_argc (1);
+	if ((d = handle_del (dir, handle_dir)) == NULL)
+		return EINVAL;
+	clear_errno ();
+	closedir (d);
+	return errno;
+}
+
+gtm_status_t
+posix_readdirn (int argc, gtm_ulong_t dir, gtm_int_t max, gtm_char_t *names /* [65536] */)
+{
+	struct dirent *b;
+	DIR *d;
+	long pos;
+	size_t l;
+	size_t s = 65536;
+	char *p = names;
+	int n = 0;
+	check_argc (3);
+	names[0] = '\0';
+	if ((d = handle_get (dir, handle_dir)) == NULL)
+		return EINVAL;
+	clear_errno ();
+	while (max <= 0 || n < max)
+	{
+		pos = telldir (d);
+		if ((b = readdir (d)) == NULL)
+			break;
+		l = strlen (b -> d_name);
+		if (l + (n > 0) >= s)
+		{
+			/* no room left, the entry will be returned by the next call */
+			seekdir (d, pos);
+			break;
+		}
+		if (n++ > 0)
+		{
+			*p++ = name_delimiter[0];
+			s--;
+		}
+		memcpy (p, b -> d_name, l);
+		p += l;
+		s -= l;
+	}
+	*p = '\0';
+	return errno;
+}
+
+/* getdents64(2) record, glibc < 2.30 does not provide getdents64 () */
+struct linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+static char
+_file_type (mode_t mode)
+{
+	if (S_ISREG (mode))
+		return 'f';
+	if (S_ISDIR (mode))
+		return 'd';
+	if (S_ISLNK (mode))
+		return 'l';
+	if (S_ISCHR (mode))
+		return 'c';
+	if (S_ISBLK (mode))
+		return 'b';
+	if (S_ISFIFO (mode))
+		return 'p';
+	if (S_ISSOCK (mode))
+		return 's';
+	return '?';
+}
+
+static char
+_dirent_type (unsigned char d_type)
+{
+	switch (d_type)
+	{
+		case DT_REG:	return 'f';
+		case DT_DIR:	return 'd';
+		case DT_LNK:	return 'l';
+		case DT_CHR:	return 'c';
+		case DT_BLK:	return 'b';
+		case DT_FIFO:	return 'p';
+		case DT_SOCK:	return 's';
+	}
+	return '?';
+}
+
+/* S_ISREG (m), S_ISDIR (m), ... for the "mode" field returned by stat */
+static gtm_int_t
+_posix_istype (int argc, gtm_ulong_t mode, mode_t type)
+{
+	check_argc (1);
+	return (mode & S_IFMT) == type;
+}
+
+gtm_int_t
+posix_sisreg (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFREG);
+}
+
+gtm_int_t
+posix_sisdir (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFDIR);
+}
+
+gtm_int_t
+posix_sischr (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFCHR);
+}
+
+gtm_int_t
+posix_sisblk (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFBLK);
+}
+
+gtm_int_t
+posix_sisfifo (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFIFO);
+}
+
+gtm_int_t
+posix_sislnk (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFLNK);
+}
+
+gtm_int_t
+posix_sissock (int argc, gtm_ulong_t mode)
+{
+	return _posix_istype (argc, mode, S_IFSOCK);
+}
+
+/* tests that all the permission bits given in octal (e.g. "0644") are set */
+gtm_int_t
+posix_sisflag (int argc, gtm_ulong_t mode, gtm_char_t *octal)
+{
+	unsigned long f;
+	check_argc (2);
+	f = strtoul (octal, NULL, 8);
+	return (mode & f) == f;
+}
+
+/*
+ * stat variant returning the file type as in scandir (e.g. "d") and the
+ * permissions in octal (e.g. "0755"), like $$octal^posix
+ */
+gtm_int_t
+posix_ftype (int argc, gtm_char_t *path, gtm_int_t nofollow, gtm_char_t *type /* [8] */,
+	gtm_char_t *octal /* [8] */)
+{
+	struct stat b;
+	check_argc (4);
+	type[0] = '\0';
+	octal[0] = '\0';
+	clear_errno ();
+	if ((nofollow ? lstat (path, &b) : stat (path, &b)) == 0)
+	{
+		type[0] = _file_type (b.st_mode);
+		type[1] = '\0';
+		snprintf (octal, 8, "%04o", (unsigned int) (b.st_mode & 07777));
+	}
+	return errno;
+}
+
+/*
+ * Directory snapshot, reads the directory with getdents64(2) and returns
+ * "/" separated "type|ino|size|mtime|name" records, size and mtime are
+ * empty unless the entry has been stat'ed, which is done only for "STAT"
+ * flag or when the filesystem does not fill d_type.
+ *
+ * The directory offset is passed in cookie (0 for the first call), it is
+ * set to -1 when there are no more entries, so the directory is reopened
+ * and read from the last returned position by each call.
+ */
+gtm_status_t
+posix_scandir (int argc, gtm_char_t *path, gtm_char_t *scan_name, gtm_long_t *cookie,
+	gtm_char_t *entries /* [65536] */)
+{
+	static char b[65536];
+	struct linux_dirent64 *d;
+	struct stat st;
+	int scan;
+	int fd;
+	long n, i;
+	int l;
+	ssize_t s = 65536;
+	char *p = entries;
+	off_t pos;
+	char type;
+	check_argc (4);
+	entries[0] = '\0';
+	check (get_flags (scan));
+	if (*cookie < 0)
+		return 0;
+	clear_errno ();
+	if ((fd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)
+		return errno;
+	pos = *cookie;
+	if (pos != 0 && lseek (fd, pos, SEEK_SET) == -1)
+		goto out;
+	while ((n = syscall (SYS_getdents64, fd, b, sizeof (b))) > 0)
+	{
+		for (i = 0; i < n; i += d -> d_reclen)
+		{
+			d = (struct linux_dirent64 *) (b + i);
+			if (d -> d_name[0] == '.' && (d -> d_name[1] == '\0' ||
+				(d -> d_name[1] == '.' && d -> d_name[2] == '\0')))
+			{
+				pos = d -> d_off;
+				continue;
+			}
+			type = _dirent_type (d -> d_type);
+			if ((scan & scan_stat) || d -> d_type == DT_UNKNOWN ||
+				((scan & scan_follow) && d -> d_type == DT_LNK))
+			{
+				if (fstatat (fd, d -> d_name, &st, (scan & scan_follow) ? 0 : AT_SYMLINK_NOFOLLOW) == -1)
+				{
+					if (errno != ENOENT)
+						goto out;
+					/* removed in the meantime */
+					clear_errno ();
+					pos = d -> d_off;
+					continue;
+				}
+				type = _file_type (st.st_mode);
+				l = snprintf (p, s, "%s%c|%llu|%lld|%lld|%s", p == entries ? "" : name_delimiter,
+					type, (unsigned long long) d -> d_ino, (long long) st.st_size,
+					(long long) st.st_mtime, d -> d_name);
+			}
+			else
+				l = snprintf (p, s, "%s%c|%llu|||%s", p == entries ? "" : name_delimiter,
+					type, (unsigned long long) d -> d_ino, d -> d_name);
+			if (l >= s)
+			{
+				/* no room left, continue from this entry in the next call */
+				*p = '\0';
+				*cookie = pos;
+				goto out;
+			}
+			p += l;
+			s -= l;
+			pos = d -> d_off;
+		}
+	}
+	if (n == 0)
+		*cookie = -1;
+out:
+	close (fd);
+	return errno;
+}
+
+/*
+ * Native "mkdir -p" and "rm -r", the trees are walked with directory file
+ * descriptors (*at() functions), so no path is resolved more than once.
+ * The path which caused the failure is copied into failed.
+ */
+
+gtm_status_t
+posix_mkpath (int argc, gtm_char_t *path, gtm_long_t mode, gtm_char_t *failed /* [4096] */)
+{
+	char *p, *q;
+	int fd, nfd;
+	int last;
+	check_argc (3);
+	failed[0] = '\0';
+	clear_errno ();
+	/* O_PATH passes through execute-only directories */
+	if ((fd = open (path[0] == '/' ? "/" : ".", O_PATH | O_DIRECTORY | O_CLOEXEC)) == -1)
+		return errno;
+	for (p = path; *p != '\0'; p = q)
+	{
+		while (*p == '/')
+			p++;
+		if (*p == '\0')
+			break;
+		for (q = p; *q != '\0' && *q != '/'; q++)
+			;
+		last = (*q == '\0' || q[strspn (q, "/")] == '\0');
+		*q = '\0';
+		if (mkdirat (fd, p, (mode_t) mode) == 0 && last)
+			break;
+		if (errno != 0 && errno != EEXIST)
+			goto out;
+		clear_errno ();
+		if ((nfd = openat (fd, p, O_PATH | O_DIRECTORY | O_CLOEXEC)) == -1)
+			goto out;
+		close (fd);
+		fd = nfd;
+		if (!last)
+			*q++ = '/';
+	}
+	close (fd);
+	return 0;
+out:
+	strncopy (failed, path, 4096);
+	close (fd);
+	return errno;
+}
+
+typedef struct
+{
+	char *p;
+	size_t size;
+}
+tree_path;
+
+/* sets path to path[0..len) "/" name, returns new length in l */
+static int
+_path_set (tree_path *t, size_t len, char *name, size_t *l)
+{
+	size_t s = strlen (name);
+	char *p;
+	if (len + s + 2 > t -> size)
+	{
+		if ((p = realloc (t -> p, (len + s + 2) * 2)) == NULL)
+			return (errno = ENOMEM);
+		t -> p = p;
+		t -> size = (len + s + 2) * 2;
+	}
+	if (len > 0)
+		t -> p[len++] = '/';
+	memcpy (t -> p + len, name, s + 1);
+	*l = len + s;
+	return 0;
+}
+
+/*
+ * Depth first removal with one frame per level. Only the deepest
+ * rmtree_open frames keep their directory open, like fts(3) the others
+ * are closed on the way down and reopened through ".." on the way up,
+ * checked against the device and inode saved when they were closed. The
+ * removal is relative to the directory fds, the path is kept only to
+ * report the failed one, so the depth is limited by memory alone.
+ */
+
+#define rmtree_open 64
+
+typedef struct
+{
+	DIR *d;		/* NULL while closed */
+	size_t off;	/* offset of the directory name in path */
+	size_t len;	/* length of the directory path */
+	dev_t dev;	/* saved when d is closed */
+	ino_t ino;
+}
+tree_frame;
+
+static int
+_rmtree (char *root, char *failed /* [4096] */)
+{
+	tree_path t = { NULL, 0 };
+	tree_frame *f = NULL;
+	tree_frame *c;
+	int n = 0, s = 0;
+	int fd;
+	int e;
+	struct dirent *b;
+	struct stat st;
+	size_t off = 0, l;
+	clear_errno ();
+	if (lstat (root, &st) == -1)
+		goto fail;
+	if (!S_ISDIR (st.st_mode))
+	{
+		if (unlink (root) == -1)
+			goto fail;
+		return 0;
+	}
+	if (_path_set (&t, 0, root, &l) != 0)
+		goto fail;
+	if ((fd = open (root, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) == -1)
+		goto fail;
+	for (;;)
+	{
+		if (fd != -1)
+		{
+			if (n == s)
+			{
+				s = s ? s * 2 : 16;
+				if ((c = realloc (f, s * sizeof (tree_frame))) == NULL)
+				{
+					close (fd);
+					errno = ENOMEM;
+					goto fail;
+				}
+				f = c;
+			}
+			if ((f[n].d = fdopendir (fd)) == NULL)
+			{
+				close (fd);
+				goto fail;
+			}
+			f[n].off = off;
+			f[n].len = l;
+			n++;
+			fd = -1;
+			if (n > rmtree_open && (c = f + n - 1 - rmtree_open) -> d != NULL)
+			{
+				if (fstat (dirfd (c -> d), &st) == -1)
+					goto fail;
+				c -> dev = st.st_dev;
+				c -> ino = st.st_ino;
+				closedir (c -> d);
+				c -> d = NULL;
+			}
+		}
+		if (n == 0)
+			break;
+		c = f + n - 1;
+		t.p[c -> len] = '\0';
+		clear_errno ();
+		if ((b = readdir (c -> d)) == NULL)
+		{
+			if (errno != 0)
+				goto fail;
+			if (n > 1 && f[n - 2].d == NULL)
+			{
+				/* the entries already removed are not read again from the reopened parent */
+				if ((fd = openat (dirfd (c -> d), "..", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) == -1)
+					goto fail;
+				if (fstat (fd, &st) == -1 || st.st_dev != f[n - 2].dev || st.st_ino != f[n - 2].ino ||
+					(f[n - 2].d = fdopendir (fd)) == NULL)
+				{
+					/* moved while closed, as fts(3) does */
+					e = (errno != 0) ? errno : ENOENT;
+					close (fd);
+					errno = e;
+					goto fail;
+				}
+				fd = -1;
+			}
+			closedir (c -> d);
+			c -> d = NULL;
+			n--;
+			if ((n == 0 ? rmdir (t.p) : unlinkat (dirfd (f[n - 1].d), t.p + c -> off, AT_REMOVEDIR)) == -1
+				&& errno != ENOENT)
+					goto fail;
+			continue;
+		}
+		if (b -> d_name[0] == '.' && (b -> d_name[1] == '\0' ||
+			(b -> d_name[1] == '.' && b -> d_name[2] == '\0')))
+				continue;
+		if (b -> d_type != DT_DIR)
+		{
+			/* unlinkat(2) is also the cheapest test for DT_UNKNOWN */
+			if (unlinkat (dirfd (c -> d), b -> d_name, 0) == 0 || errno == ENOENT)
+				continue;
+			if (errno != EISDIR || b -> d_type != DT_UNKNOWN)
+			{
+				e = errno;
+				if (_path_set (&t, c -> len, b -> d_name, &l) == 0)
+					errno = e;
+				goto fail;
+			}
+		}
+		off = c -> len + 1;
+		if (_path_set (&t, c -> len, b -> d_name, &l) != 0)
+			goto fail;
+		if ((fd = openat (dirfd (c -> d), b -> d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) == -1)
+		{
+			if (errno == ENOENT)
+				continue;
+			goto fail;
+		}
+	}
+	free (f);
+	free (t.p);
+	return 0;
+fail:
+	e = errno;
+	strncopy (failed, t.p != NULL ? t.p : root, 4096);
+	while (n > 0)
+		if (f[--n].d != NULL)
+			closedir (f[n].d);
+	free (f);
+	free (t.p);
+	return e;
+}
+
+/*
+ * Parallel tree walk, the directories are processed by a pool of worker
+ * threads, each with its own work queue (LIFO for the owner, stolen FIFO
+ * by idle workers) and its own file descriptors. The calling thread takes
+ * part as the first worker. Workers run with all signals blocked and never
+ * touch GT.M (or this library's handle table), the results are merged by
+ * the calling thread when all workers are done.
+ *
+ * A directory is removed when it has been read and all its subdirectories
+ * are gone, which is tracked with the pending counter of each node. Like
+ * _rmtree the nodes are opened and removed relative to the fd of their
+ * parent, held open until the parent is done, so the open fds are the
+ * directories with subdirectories in progress and the path is built only
+ * for the failed report.
+ */
+
+#define tree_rm 0
+#define tree_walk 1
+
+#define tree_threads_limit 64
+
+typedef struct tree_node
+{
+	struct tree_node *parent;
+	long pending;
+	int fd;		/* for the subdirectories, -1 until the first one is queued */
+	char name[];
+}
+tree_node;
+
+typedef struct
+{
+	gtm_ulong_t dirs;
+	gtm_ulong_t files;
+	gtm_ulong_t links;
+	gtm_ulong_t others;
+	gtm_ulong_t size;
+	gtm_ulong_t blocks;
+	gtm_ulong_t mtime;
+}
+tree_stat;
+
+struct tree_pool;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	tree_node **q;
+	size_t size;
+	size_t head;
+	size_t count;
+	tree_stat st;
+	struct tree_pool *pool;
+	int id;
+}
+tree_worker;
+
+typedef struct tree_pool
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	tree_worker *w;
+	int threads;
+	int op;
+	volatile long queued;	/* nodes waiting in the queues */
+	volatile long outstanding;	/* nodes queued or being processed */
+	volatile long idle;
+	volatile int error;
+	char failed[4096];
+}
+tree_pool;
+
+/* the directory fd the node is relative to */
+#define tree_at(n) ((n) -> parent != NULL ? (n) -> parent -> fd : AT_FDCWD)
+
+/* name: the failed entry of the directory n, NULL for n itself */
+static void
+_tree_fail (tree_pool *p, int e, tree_node *n, char *name)
+{
+	tree_node *c;
+	size_t l, s;
+	char *o;
+	pthread_mutex_lock (&p -> lock);
+	if (p -> error == 0)
+	{
+		p -> error = e;
+		l = name ? strlen (name) : 0;
+		for (c = n; c != NULL; c = c -> parent)
+			l += strlen (c -> name) + (l > 0);
+		/* joined from the last name back to the root */
+		if ((o = malloc (l + 1)) != NULL)
+		{
+			o[l] = '\0';
+			if (name != NULL)
+			{
+				l -= strlen (name);
+				memcpy (o + l, name, strlen (name));
+			}
+			for (c = n; c != NULL; c = c -> parent)
+			{
+				s = strlen (c -> name);
+				if (o[l] != '\0')
+					o[--l] = '/';
+				l -= s;
+				memcpy (o + l, c -> name, s);
+			}
+			strncopy (p -> failed, o, sizeof (p -> failed));
+			free (o);
+		}
+	}
+	pthread_mutex_unlock (&p -> lock);
+}
+
+static tree_node *
+_tree_node (tree_node *parent, char *name)
+{
+	size_t s = strlen (name);
+	tree_node *n;
+	if ((n = malloc (sizeof (tree_node) + s + 1)) == NULL)
+		return NULL;
+	n -> parent = parent;
+	n -> pending = 1;
+	n -> fd = -1;
+	memcpy (n -> name, name, s + 1);
+	return n;
+}
+
+static int
+_tree_push (tree_worker *w, tree_node *n)
+{
+	tree_pool *p = w -> pool;
+	tree_node **q;
+	size_t i;
+	/* counted before the node can be stolen, full barrier for the idle test below */
+	__sync_add_and_fetch (&p -> outstanding, 1);
+	__sync_add_and_fetch (&p -> queued, 1);
+	pthread_mutex_lock (&w -> lock);
+	if (w -> count == w -> size)
+	{
+		if ((q = malloc ((w -> size ? w -> size * 2 : 64) * sizeof (tree_node *))) == NULL)
+		{
+			pthread_mutex_unlock (&w -> lock);
+			__sync_sub_and_fetch (&p -> queued, 1);
+			__sync_sub_and_fetch (&p -> outstanding, 1);
+			return ENOMEM;
+		}
+		for (i = 0; i < w -> count; i++)
+			q[i] = w -> q[(w -> head + i) % w -> size];
+		free (w -> q);
+		w -> q = q;
+		w -> head = 0;
+		w -> size = w -> size ? w -> size * 2 : 64;
+	}
+	w -> q[(w -> head + w -> count++) % w -> size] = n;
+	pthread_mutex_unlock (&w -> lock);
+	if (p -> idle > 0)
+	{
+		pthread_mutex_lock (&p -> lock);
+		pthread_cond_signal (&p -> cond);
+		pthread_mutex_unlock (&p -> lock);
+	}
+	return 0;
+}
+
+static tree_node *
+_tree_pop (tree_worker *w, int steal)
+{
+	tree_node *n = NULL;
+	pthread_mutex_lock (&w -> lock);
+	if (w -> count > 0)
+	{
+		if (steal)
+		{
+			n = w -> q[w -> head];
+			w -> head = (w -> head + 1) % w -> size;
+		}
+		else
+			n = w -> q[(w -> head + w -> count - 1) % w -> size];
+		w -> count--;
+	}
+	pthread_mutex_unlock (&w -> lock);
+	if (n != NULL)
+		__sync_sub_and_fetch (&w -> pool -> queued, 1);
+	return n;
+}
+
+/* drops the reference held by the node itself or by one of its subdirectories */
+static void
+_tree_done (tree_pool *p, tree_node *n)
+{
+	tree_node *parent;
+	while (n != NULL && __sync_sub_and_fetch (&n -> pending, 1) == 0)
+	{
+		if (n -> fd != -1)
+			close (n -> fd);
+		if (p -> op == tree_rm && p -> error == 0 && unlinkat (tree_at (n), n -> name, AT_REMOVEDIR) == -1 &&
+			errno != ENOENT)
+				_tree_fail (p, errno, n, NULL);
+		parent = n -> parent;
+		free (n);
+		n = parent;
+	}
+}
+
+static void
+_tree_entry_stat (tree_stat *t, struct stat *st)
+{
+	if (S_ISDIR (st -> st_mode))
+		t -> dirs++;
+	else if (S_ISREG (st -> st_mode))
+		t -> files++;
+	else if (S_ISLNK (st -> st_mode))
+		t -> links++;
+	else
+		t -> others++;
+	t -> size += st -> st_size;
+	t -> blocks += st -> st_blocks;
+	if ((gtm_ulong_t) st -> st_mtime > t -> mtime)
+		t -> mtime = st -> st_mtime;
+}
+
+static void
+_tree_dir (tree_worker *w, tree_node *n)
+{
+	tree_pool *p = w -> pool;
+	struct dirent *b;
+	struct stat st;
+	tree_node *c;
+	int fd, dir, e;
+	DIR *d;
+	if (p -> error != 0)
+		return;
+	if ((fd = openat (tree_at (n), n -> name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) == -1)
+	{
+		if (errno != ENOENT)
+			_tree_fail (p, errno, n, NULL);
+		return;
+	}
+	if ((d = fdopendir (fd)) == NULL)
+	{
+		_tree_fail (p, errno, n, NULL);
+		close (fd);
+		return;
+	}
+	for (;;)
+	{
+		errno = 0;
+		if ((b = readdir (d)) == NULL)
+		{
+			if (errno != 0)
+				_tree_fail (p, errno, n, NULL);
+			break;
+		}
+		if (b -> d_name[0] == '.' && (b -> d_name[1] == '\0' ||
+			(b -> d_name[1] == '.' && b -> d_name[2] == '\0')))
+				continue;
+		dir = (b -> d_type == DT_DIR);
+		if (p -> op == tree_walk)
+		{
+			if (fstatat (fd, b -> d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+			{
+				if (errno == ENOENT)
+					continue;
+				_tree_fail (p, errno, n, b -> d_name);
+				break;
+			}
+			_tree_entry_stat (&w -> st, &st);
+			dir = S_ISDIR (st.st_mode);
+		}
+		else if (!dir)
+		{
+			if (unlinkat (fd, b -> d_name, 0) == 0 || errno == ENOENT)
+				continue;
+			if (errno != EISDIR || b -> d_type != DT_UNKNOWN)
+			{
+				_tree_fail (p, errno, n, b -> d_name);
+				break;
+			}
+			dir = 1;
+		}
+		if (!dir)
+			continue;
+		/* closedir() closes fd, the subdirectories keep their own copy */
+		if (n -> fd == -1 && (n -> fd = fcntl (fd, F_DUPFD_CLOEXEC, 0)) == -1)
+		{
+			_tree_fail (p, errno, n, NULL);
+			break;
+		}
+		if ((c = _tree_node (n, b -> d_name)) == NULL)
+		{
+			_tree_fail (p, ENOMEM, n, b -> d_name);
+			break;
+		}
+		__sync_add_and_fetch (&n -> pending, 1);
+		if ((e = _tree_push (w, c)) != 0)
+		{
+			_tree_fail (p, e, n, b -> d_name);
+			__sync_sub_and_fetch (&n -> pending, 1);
+			free (c);
+			break;
+		}
+	}
+	closedir (d);
+}
+
+static void *
+_tree_worker (void *arg)
+{
+	tree_worker *w = arg;
+	tree_pool *p = w -> pool;
+	tree_node *n;
+	int i;
+	for (;;)
+	{
+		n = _tree_pop (w, 0);
+		for (i = 1; n == NULL && i < p -> threads; i++)
+			n = _tree_pop (p -> w + (w -> id + i) % p -> threads, 1);
+		if (n != NULL)
+		{
+			_tree_dir (w, n);
+			_tree_done (p, n);
+			if (__sync_sub_and_fetch (&p -> outstanding, 1) == 0)
+			{
+				pthread_mutex_lock (&p -> lock);
+				pthread_cond_broadcast (&p -> cond);
+				pthread_mutex_unlock (&p -> lock);
+			}
+			continue;
+		}
+		pthread_mutex_lock (&p -> lock);
+		__sync_add_and_fetch (&p -> idle, 1);
+		while (p -> queued <= 0 && p -> outstanding > 0)
+			pthread_cond_wait (&p -> cond, &p -> lock);
+		__sync_sub_and_fetch (&p -> idle, 1);
+		i = (p -> outstanding == 0);
+		pthread_mutex_unlock (&p -> lock);
+		if (i)
+			break;
+	}
+	return NULL;
+}
+
+static int
+_tree_run (int op, char *root, int threads, tree_stat *st, char *failed /* [4096] */)
+{
+	tree_pool p;
+	tree_node *n;
+	pthread_t t[tree_threads_limit];
+	sigset_t all, old;
+	int i, c = 0;
+	if (threads < 1)
+		threads = 1;
+	if (threads > tree_threads_limit)
+		threads = tree_threads_limit;
+	memset (&p, '\0', sizeof (p));
+	if ((p.w = calloc (threads, sizeof (tree_worker))) == NULL)
+		return ENOMEM;
+	pthread_mutex_init (&p.lock, NULL);
+	pthread_cond_init (&p.cond, NULL);
+	p.threads = threads;
+	p.op = op;
+	for (i = 0; i < threads; i++)
+	{
+		pthread_mutex_init (&p.w[i].lock, NULL);
+		p.w[i].pool = &p;
+		p.w[i].id = i;
+	}
+	if ((n = _tree_node (NULL, root)) == NULL || _tree_push (p.w, n) != 0)
+	{
+		free (n);
+		p.error = ENOMEM;
+	}
+	else
+	{
+		sigfillset (&all);
+		pthread_sigmask (SIG_SETMASK, &all, &old);
+		for (c = 0; c < threads - 1; c++)
+			if (pthread_create (t + c, NULL, _tree_worker, p.w + c + 1) != 0)
+				break;
+		pthread_sigmask (SIG_SETMASK, &old, NULL);
+		_tree_worker (p.w);
+		for (i = 0; i < c; i++)
+			pthread_join (t[i], NULL);
+	}
+	for (i = 0; i < threads; i++)
+	{
+		if (st != NULL)
+		{
+			st -> dirs += p.w[i].st.dirs;
+			st -> files += p.w[i].st.files;
+			st -> links += p.w[i].st.links;
+			st -> others += p.w[i].st.others;
+			st -> size += p.w[i].st.size;
+			st -> blocks += p.w[i].st.blocks;
+			if (p.w[i].st.mtime > st -> mtime)
+				st -> mtime = p.w[i].st.mtime;
+		}
+		free (p.w[i].q);
+		pthread_mutex_destroy (&p.w[i].lock);
+	}
+	free (p.w);
+	pthread_cond_destroy (&p.cond);
+	pthread_mutex_destroy (&p.lock);
+	if (p.error != 0)
+		strncopy (failed, p.failed, 4096);
+	return p.error;
+}
+
+gtm_status_t
+posix_rmpath (int argc, gtm_char_t *path, gtm_int_t threads, gtm_char_t *failed /* [4096] */)
+{
+	struct stat st;
+	check_argc (3);
+	failed[0] = '\0';
+	if (threads <= 1)
+		return _rmtree (path, failed);
+	clear_errno ();
+	if (lstat (path, &st) == -1 || (!S_ISDIR (st.st_mode) && unlink (path) == -1))
+	{
+		strncopy (failed, path, 4096);
+		return errno;
+	}
+	if (!S_ISDIR (st.st_mode))
+		return 0;
+	return _tree_run (tree_rm, path, threads, NULL, failed);
+}
+
+gtm_int_t
+posix_walk (int argc, gtm_char_t *path, gtm_int_t threads, gtm_char_t *failed /* [4096] */,
+	gtm_ulong_t *dirs, gtm_ulong_t *files, gtm_ulong_t *links, gtm_ulong_t *others,
+	gtm_ulong_t *size, gtm_ulong_t *blocks, gtm_ulong_t *mtime)
+{
+	tree_stat st;
+	int e;
+	check_argc (10);
+	failed[0] = '\0';
+	memset (&st, '\0', sizeof (st));
+	e = _tree_run (tree_walk, path, threads, &st, failed);
+	*dirs = st.dirs;
+	*files = st.files;
+	*links = st.links;
+	*others = st.others;
+	*size = st.size;
+	*blocks = st.blocks;
+	*mtime = st.mtime;
+	return e;
+}
+
+gtm_status_t
+posix_param (int argc, gtm_char_t *table, gtm_char_t *name, gtm_int_t *value)
+{
+	size_t i;
+	check_argc (3);
+	*value = 0;
+	for (i = 0; i < sizeof (param_list) / sizeof (param_list[0]); i++)
+		if (strcasecmp (param_list[i].name, table) == 0)
+		{
+			check ((param_list[i].flags ? _get_flags : _get_param) (param_list[i].p, param_list[i].n, name, value));
+			return 0;
+		}
+	return EINVAL;
+}
+
+/*
+ * Latency histograms, log-linear buckets (HdrHistogram like), values below
+ * 2^hist_bits are counted exactly, above that every power of 2 range is
+ * split into 2^(hist_bits - 1) buckets, which keeps the relative error
+ * below 1/128. Recording is O(1), does not allocate and uses atomic
+ * increments only, so a histogram can be shared between processes in a
+ * POSIX shared memory object, where all-zero memory is an empty histogram.
+ */
+
+#define hist_bits 8
+#define hist_sub (1 << hist_bits)
+#define hist_half (hist_sub / 2)
+#define hist_buckets (hist_sub + (64 - hist_bits) * hist_half)
+#define hist_magic (0x47504801 + hist_bits)
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t nmin;	/* ~min, so that zeroed memory means no min yet */
+	uint64_t bucket[hist_buckets];
+}
+hist_data;
+
+typedef struct
+{
+	hist_data *d;
+	int shared;
+}
+hist;
+
+static inline unsigned int
+_hist_index (uint64_t v)
+{
+	unsigned int e;
+	if (v < hist_sub)
+		return v;
+	e = 63 - __builtin_clzll (v) - hist_bits + 1;
+	return hist_sub + (e - 1) * hist_half + (v >> e) - hist_half;
+}
+
+/* highest value counted in bucket i */
+static uint64_t
+_hist_value (unsigned int i)
+{
+	unsigned int e;
+	if (i < hist_sub)
+		return i;
+	i -= hist_sub;
+	e = i / hist_half + 1;
+	return (((uint64_t) (i % hist_half + hist_half + 1)) << e) - 1;
+}
+
+static inline void
+_hist_max (uint64_t *p, uint64_t v)
+{
+	uint64_t o;
+	while ((o = *(volatile uint64_t *) p) < v)
+		if (__sync_bool_compare_and_swap (p, o, v))
+			break;
+}
+
+static int
+_shm_map (const char *prefix, const char *name, size_t size, void **p)
+{
+	char b[256];
+	struct stat st;
+	int fd;
+	if (strchr (name, '/') != NULL || snprintf (b, sizeof (b), "/%s%s", prefix, name) >= (int) sizeof (b))
+		return EINVAL;
+	clear_errno ();
+	if ((fd = shm_open (b, O_RDWR | O_CREAT | O_CLOEXEC, 0660)) == -1)
+		return errno;
+	if (fstat (fd, &st) == -1 || (st.st_size == 0 && ftruncate (fd, size) == -1))
+		goto out;
+	if (st.st_size != 0 && (size_t) st.st_size != size)
+	{
+		errno = EINVAL;
+		goto out;
+	}
+	if ((*p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		*p = NULL;
+out:
+	close (fd);
+	return errno;
+}
+
+gtm_status_t
+posix_hcreate (int argc, gtm_char_t *name, gtm_ulong_t *h)
+{
+	hist *b;
+	void *p = NULL;
+	int e;
+	check_argc (2);
+	*h = 0;
+	if ((b = malloc (sizeof (hist))) == NULL)
+		return ENOMEM;
+	if ((b -> shared = (name[0] != '\0')))
+	{
+		if ((e = _shm_map ("gtm-posix-hist.", name, sizeof (hist_data), &p)) != 0)
+		{
+			free (b);
+			return e;
+		}
+		if (!__sync_bool_compare_and_swap (&((hist_data *) p) -> magic, 0, hist_magic) &&
+			((hist_data *) p) -> magic != hist_magic)
+		{
+			munmap (p, sizeof (hist_data));
+			free (b);
+			return EINVAL;
+		}
+	}
+	else if ((p = calloc (1, sizeof (hist_data))) == NULL)
+	{
+		free (b);
+		return ENOMEM;
+	}
+	b -> d = p;
+	if ((e = handle_new (handle_hist, b, h)) != 0)
+	{
+		if (b -> shared)
+			munmap (p, sizeof (hist_data));
+		else
+			free (p);
+		free (b);
+	}
+	return e;
+}
+
+gtm_status_t
+posix_hrecord (int argc, gtm_ulong_t h, gtm_long_t v)
+{
+	hist *b;
+	hist_data *d;
+	check_argc (2);
+	if ((b = handle_get (h, handle_hist)) == NULL)
+		return EINVAL;
+	if (v < 0)
+		v = 0;
+	d = b -> d;
+	__sync_fetch_and_add (&d -> bucket[_hist_index (v)], 1);
+	__sync_fetch_and_add (&d -> count, 1);
+	__sync_fetch_and_add (&d -> sum, v);
+	_hist_max (&d -> max, v);
+	_hist_max (&d -> nmin, ~(uint64_t) v);
+	return 0;
+}
+
+gtm_status_t
+posix_hpercentile (int argc, gtm_ulong_t h, gtm_char_t *percentile, gtm_long_t *value)
+{
+	hist *b;
+	hist_data *d;
+	uint64_t n, r, c = 0;
+	unsigned int i;
+	char *e;
+	double p;
+	check_argc (3);
+	*value = 0;
+	if ((b = handle_get (h, handle_hist)) == NULL)
+		return EINVAL;
+	p = strtod (percentile, &e);
+	if (e == percentile || *e != '\0' || p < 0 || p > 100)
+		return EINVAL;
+	d = b -> d;
+	if ((n = d -> count) == 0)
+		return 0;
+	/* rank of the value, rounded up */
+	if ((r = (uint64_t) (p / 100 * n)) < p / 100 * n || r == 0)
+		r++;
+	for (i = 0; i < hist_buckets; i++)
+		if ((c += d -> bucket[i]) >= r)
+			break;
+	*value = i < hist_buckets ? _hist_value (i) : d -> max;
+	if ((uint64_t) *value > d -> max)
+		*value = d -> max;
+	if ((uint64_t) *value < ~d -> nmin)
+		*value = ~d -> nmin;
+	return 0;
+}
+
+gtm_status_t
+posix_hstat (int argc, gtm_ulong_t h, gtm_ulong_t *count, gtm_ulong_t *sum, gtm_ulong_t *min, gtm_ulong_t *max)
+{
+	hist *b;
+	check_argc (5);
+	*count = *sum = *min = *max = 0;
+	if ((b = handle_get (h, handle_hist)) == NULL)
+		return EINVAL;
+	if ((*count = b -> d -> count) > 0)
+	{
+		*sum = b -> d -> sum;
+		*min = ~b -> d -> nmin;
+		*max = b -> d -> max;
+	}
+	return 0;
+}
+
+/* "|" separated "value:count" pairs of non-empty buckets, value is the highest value of a bucket */
+gtm_status_t
+posix_hdump (int argc, gtm_ulong_t h, gtm_char_t *dump /* [65536] */)
+{
+	hist *b;
+	unsigned int i;
+	uint64_t c;
+	ssize_t s = 65536;
+	int l;
+	char *p = dump;
+	check_argc (2);
+	dump[0] = '\0';
+	if ((b = handle_get (h, handle_hist)) == NULL)
+		return EINVAL;
+	for (i = 0; i < hist_buckets; i++)
+		if ((c = b -> d -> bucket[i]) != 0)
+		{
+			l = snprintf (p, s, "%s%llu:%llu", p == dump ? "" : list_delimiter,
+				(unsigned long long) _hist_value (i), (unsigned long long) c);
+			if (l >= s)
+			{
+				*p = '\0';
+				return ERANGE;
+			}
+			p += l;
+			s -= l;
+		}
+	return 0;
+}
+
+gtm_status_t
+posix_hreset (int argc, gtm_ulong_t h)
+{
+	hist *b;
+	check_argc (1);
+	if ((b = handle_get (h, handle_hist)) == NULL)
+		return EINVAL;
+	memset (&b -> d -> count, '\0', sizeof (hist_data) - offsetof (hist_data, count));
+	return 0;
+}
+
+gtm_status_t
+posix_hclose (int argc, gtm_ulong_t h)
+{
+	hist *b;
+	check_argc (1);
+	if ((b = handle_del (h, handle_hist)) == NULL)
+		return EINVAL;
+	if (b -> shared)
+		munmap (b -> d, sizeof (hist_data));
+	else
+		free (b -> d);
+	free (b);
+	return 0;
+}
+
+gtm_status_t
+posix_hremove (int argc, gtm_char_t *name)
+{
+	char b[256];
+	check_argc (1);
+	if (strchr (name, '/') != NULL || snprintf (b, sizeof (b), "/gtm-posix-hist.%s", name) >= (int) sizeof (b))
+		return EINVAL;
+	clear_errno ();
+	shm_unlink (b);
+	return errno;
+}
+
+/*
+ * Read-only file mappings, slices are copied straight from the page cache
+ * into M strings, without staging reads through a device buffer. Offsets
+ * are 0 based.
+ */
+
+typedef struct
+{
+	char *p;
+	size_t size;
+}
+mapping;
+
+gtm_status_t
+posix_mmap (int argc, gtm_char_t *path, gtm_char_t *map_name, gtm_ulong_t *h, gtm_long_t *size)
+{
+	struct stat st;
+	int map;
+	int fd;
+	int e;
+	mapping *m;
+	check_argc (4);
+	*h = 0;
+	*size = 0;
+	check (get_flags (map));
+	clear_errno ();
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+		return errno;
+	if (fstat (fd, &st) == -1 || (m = malloc (sizeof (mapping))) == NULL)
+	{
+		e = errno;
+		close (fd);
+		return e;
+	}
+	m -> p = NULL;
+	m -> size = st.st_size;
+	/* mmap(2) refuses zero length, an empty file maps to nothing */
+	if (m -> size > 0 && (m -> p = mmap (NULL, m -> size, PROT_READ,
+		MAP_SHARED | ((map & map_populate) ? MAP_POPULATE : 0), fd, 0)) == MAP_FAILED)
+	{
+		e = errno;
+		close (fd);
+		free (m);
+		return e;
+	}
+	close (fd);
+	/* advice is only a hint, failures are ignored */
+	if (m -> size > 0)
+	{
+		if (map & map_random)
+			madvise (m -> p, m -> size, MADV_RANDOM);
+		if (map & map_sequential)
+			madvise (m -> p, m -> size, MADV_SEQUENTIAL);
+		if (map & map_willneed)
+			madvise (m -> p, m -> size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+		if (map & map_hugepage)
+			madvise (m -> p, m -> size, MADV_HUGEPAGE);
+#endif
+	}
+	if ((e = handle_new (handle_map, m, h)) != 0)
+	{
+		if (m -> size > 0)
+			munmap (m -> p, m -> size);
+		free (m);
+		return e;
+	}
+	*size = m -> size;
+	return 0;
+}
+
+gtm_status_t
+posix_mread (int argc, gtm_ulong_t h, gtm_long_t offset, gtm_long_t len, gtm_string_t *s /* [1048576] */)
+{
+	mapping *m;
+	check_argc (4);
+	s -> length = 0;
+	if ((m = handle_get (h, handle_map)) == NULL || offset < 0 || len < 0)
+		return EINVAL;
+	if ((size_t) offset >= m -> size)
+		return 0;
+	if ((size_t) len > m -> size - offset)
+		len = m -> size - offset;
+	if (len > 1048576)
+		len = 1048576;
+	memcpy (s -> address, m -> p + offset, len);
+	s -> length = len;
+	return 0;
+}
+
+gtm_status_t
+posix_mfind (int argc, gtm_ulong_t h, gtm_long_t offset, gtm_int_t byte, gtm_long_t *pos)
+{
+	mapping *m;
+	char *p;
+	check_argc (4);
+	*pos = -1;
+	if ((m = handle_get (h, handle_map)) == NULL || offset < 0 || byte < 0 || byte > 255)
+		return EINVAL;
+	if ((size_t) offset < m -> size && (p = memchr (m -> p + offset, byte, m -> size - offset)) != NULL)
+		*pos = p - m -> p;
+	return 0;
+}
+
+/*
+ * Record splitting, the delimiter is searched 16 bytes at a time with SSE2
+ * (always available on x86-64) and byte by byte elsewhere. The kernel is
+ * inlined, so short records in a batch do not pay a memchr(3) call each.
+ */
+
+static inline const char *
+_map_byte (const char *p, const char *end, char c)
+{
+#ifdef __SSE2__
+	__m128i v = _mm_set1_epi8 (c);
+	int m;
+	for (; end - p >= 16; p += 16)
+		if ((m = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) p), v))) != 0)
+			return p + __builtin_ctz (m);
+#endif
+	for (; p < end; p++)
+		if (*p == c)
+			return p;
+	return NULL;
+}
+
+/* returns the delimiter following p or NULL */
+static const char *
+_map_delim (const char *p, const char *end, const char *d, size_t l)
+{
+	while ((p = _map_byte (p, end, d[0])) != NULL)
+	{
+		if ((size_t) (end - p) >= l && memcmp (p + 1, d + 1, l - 1) == 0)
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+/*
+ * Returns in s up to max records starting at 0 based offset pos, joined
+ * with the delimiter, so that M code can $piece them. pos is advanced past
+ * the delimiter of the last record returned and set to -1 at the end of the
+ * mapping. ERANGE is returned when the first record does not fit in s.
+ */
+static gtm_status_t
+_map_next (gtm_ulong_t h, gtm_long_t *pos, gtm_char_t *delim, gtm_int_t max,
+	gtm_string_t *s /* [1048576] */, gtm_int_t *n)
+{
+	mapping *m;
+	const char *p, *q, *e, *end, *last;
+	size_t l = strlen (delim);
+	size_t size = 1048576;
+	int i;
+	s -> length = 0;
+	*n = 0;
+	if ((m = handle_get (h, handle_map)) == NULL || l == 0 || max < 1)
+		return EINVAL;
+	if (*pos < 0 || (size_t) *pos >= m -> size)
+	{
+		*pos = -1;
+		return 0;
+	}
+	p = m -> p + *pos;
+	end = m -> p + m -> size;
+	last = p;
+	for (i = 0; i < max && p < end; i++)
+	{
+		if ((q = _map_delim (p, end, delim, l)) == NULL)
+			q = e = end;
+		else
+			e = q + l;
+		if ((size_t) (q - (m -> p + *pos)) > size)
+		{
+			if (i == 0)
+				return ERANGE;
+			break;
+		}
+		last = q;
+		p = e;
+	}
+	s -> length = last - (m -> p + *pos);
+	memcpy (s -> address, m -> p + *pos, s -> length);
+	*n = i;
+	*pos = (p < end) ? p - m -> p : -1;
+	return 0;
+}
+
+gtm_status_t
+posix_mnext (int argc, gtm_ulong_t h, gtm_long_t *pos, gtm_char_t *delim, gtm_string_t *s /* [1048576] */)
+{
+	gtm_int_t n;
+	check_argc (4);
+	return _map_next (h, pos, delim, 1, s, &n);
+}
+
+gtm_status_t
+posix_mnextn (int argc, gtm_ulong_t h, gtm_long_t *pos, gtm_char_t *delim, gtm_int_t max,
+	gtm_string_t *s /* [1048576] */, gtm_int_t *n)
+{
+	check_argc (6);
+	return _map_next (h, pos, delim, max, s, n);
+}
+
+gtm_status_t
+posix_munmap (int argc, gtm_ulong_t h)
+{
+	mapping *m;
+	check_argc (1);
+	if ((m = handle_del (h, handle_map)) == NULL)
+		return EINVAL;
+	if (m -> size > 0)
+		munmap (m -> p, m -> size);
+	free (m);
+	return 0;
+}
+
+/*
+ * Directory (or file) watch, inotify(7) based. Events read from the kernel
+ * are buffered in the handle, so those which do not fit the output are
+ * returned by the next wpoll.
+ */
+
+typedef struct
+{
+	int fd;
+	size_t off;
+	size_t len;
+	char buf[16384] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+}
+watcher;
+
+/* the event names reported back, in the order they are listed */
+static const param watch_event[] = {
+	{ "ACCESS",		IN_ACCESS },
+	{ "MODIFY",		IN_MODIFY },
+	{ "ATTRIB",		IN_ATTRIB },
+	{ "CLOSE_WRITE",	IN_CLOSE_WRITE },
+	{ "CLOSE_NOWRITE",	IN_CLOSE_NOWRITE },
+	{ "OPEN",		IN_OPEN },
+	{ "MOVED_FROM",		IN_MOVED_FROM },
+	{ "MOVED_TO",		IN_MOVED_TO },
+	{ "CREATE",		IN_CREATE },
+	{ "DELETE",		IN_DELETE },
+	{ "DELETE_SELF",	IN_DELETE_SELF },
+	{ "MOVE_SELF",		IN_MOVE_SELF },
+	{ "UNMOUNT",		IN_UNMOUNT },
+	{ "Q_OVERFLOW",		IN_Q_OVERFLOW },
+	{ "IGNORED",		IN_IGNORED },
+	{ "ISDIR",		IN_ISDIR }
+};
+
+gtm_status_t
+posix_watch (int argc, gtm_char_t *path, gtm_char_t *watch_name, gtm_ulong_t *h)
+{
+	int watch;
+	watcher *w;
+	int e;
+	check_argc (3);
+	*h = 0;
+	check (get_flags (watch));
+	if ((w = malloc (sizeof (*w))) == NULL)
+		return ENOMEM;
+	w -> off = w -> len = 0;
+	clear_errno ();
+	if ((w -> fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC)) == -1)
+	{
+		free (w);
+		return errno;
+	}
+	if (inotify_add_watch (w -> fd, path, watch ? (uint32_t) watch : IN_ALL_EVENTS) == -1 ||
+		(errno = handle_new (handle_watch, w, h)) != 0)
+	{
+		e = errno;
+		close (w -> fd);
+		free (w);
+		return e;
+	}
+	return 0;
+}
+
+/*
+ * Waits up to timeout milliseconds (-1 forever) for events and returns
+ * them as "/" separated "events|cookie|name" records, events are ","
+ * joined names, name is empty for the watched path itself. n is set to 0
+ * on timeout or when interrupted by a signal.
+ */
+gtm_status_t
+posix_wpoll (int argc, gtm_ulong_t h, gtm_int_t timeout, gtm_char_t *events /* [65536] */, gtm_int_t *n)
+{
+	struct inotify_event *ev;
+	struct pollfd p;
+	watcher *w;
+	char r[1024];
+	char *o = events;
+	size_t s = 65536;
+	size_t i, l;
+	ssize_t k;
+	check_argc (4);
+	events[0] = '\0';
+	*n = 0;
+	if ((w = handle_get (h, handle_watch)) == NULL)
+		return EINVAL;
+	if (w -> off >= w -> len)
+	{
+		w -> off = w -> len = 0;
+		p.fd = w -> fd;
+		p.events = POLLIN;
+		if ((k = poll (&p, 1, timeout)) == 0 || (k == -1 && errno == EINTR))
+			return 0;
+		if (k == -1)
+			return errno;
+		if ((k = read (w -> fd, w -> buf, sizeof (w -> buf))) == -1)
+			return (errno == EAGAIN || errno == EINTR) ? 0 : errno;
+		w -> len = k;
+	}
+	while (w -> off < w -> len)
+	{
+		ev = (struct inotify_event *) (w -> buf + w -> off);
+		for (l = i = 0; i < sizeof (watch_event) / sizeof (param); i++)
+			if (ev -> mask & watch_event[i].value)
+				l += snprintf (r + l, sizeof (r) - l, "%s%s", (l ? "," : ""), watch_event[i].name);
+		l += snprintf (r + l, sizeof (r) - l, "|%u|%s", ev -> cookie, (ev -> len ? ev -> name : ""));
+		if (l + (o != events) >= s)
+		{
+			if (o == events)
+				return ERANGE;
+			break;
+		}
+		if (o != events)
+		{
+			*o++ = name_delimiter[0];
+			s--;
+		}
+		memcpy (o, r, l + 1);
+		o += l;
+		s -= l;
+		(*n)++;
+		w -> off += sizeof (struct inotify_event) + ev -> len;
+	}
+	return 0;
+}
+
+gtm_status_t
+posix_unwatch (int argc, gtm_ulong_t h)
+{
+	watcher *w;
+	check_argc (1);
+	if ((w = handle_del (h, handle_watch)) == NULL)
+		return EINVAL;
+	close (w -> fd);
+	free (w);
+	return 0;
+}
+
+/*
+ * Counters and gauges, named 64-bit slots updated with atomic instructions,
+ * so named segments can be shared by all the processes on the node through
+ * POSIX shared memory, like histograms. Each slot takes a cache line of its
+ * own, so processes updating different counters do not contend. A slot is
+ * claimed for a name once and never released, until the segment is removed.
+ */
+
+#define counter_magic 0x47504301
+#define counter_name_size 48
+#define counter_slots 1024
+#define counter_claim_wait 10000000
+
+enum
+{
+	counter_free = 0,
+	counter_claiming,
+	counter_ready
+};
+
+typedef struct
+{
+	volatile int64_t value;
+	volatile uint32_t state;
+	uint32_t reserved;
+	char name[counter_name_size];
+}
+__attribute__ ((aligned (64))) counter_slot;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t slots;
+	char reserved[56];
+	counter_slot slot[];
+}
+__attribute__ ((aligned (64))) counter_data;
+
+typedef struct
+{
+	counter_data *d;
+	size_t size;
+	int shared;
+}
+counter;
+
+static counter_slot *
+_counter_slot (gtm_ulong_t h, gtm_int_t slot)
+{
+	counter *c;
+	if ((c = handle_get (h, handle_counter)) == NULL || slot < 0 || (uint32_t) slot >= c -> d -> slots)
+		return NULL;
+	return c -> d -> slot + slot;
+}
+
+/* slots: number of counters in the segment, 0 for the default 1024, same for all the processes */
+gtm_status_t
+posix_ccreate (int argc, gtm_char_t *name, gtm_int_t slots, gtm_ulong_t *h)
+{
+	counter *c;
+	void *p = NULL;
+	size_t size;
+	int e;
+	check_argc (3);
+	*h = 0;
+	if (slots == 0)
+		slots = counter_slots;
+	if (slots < 0 || slots > (1 << 20))
+		return EINVAL;
+	size = sizeof (counter_data) + slots * sizeof (counter_slot);
+	if ((c = malloc (sizeof (counter))) == NULL)
+		return ENOMEM;
+	if ((c -> shared = (name[0] != '\0')))
+	{
+		if ((e = _shm_map ("gtm-posix-counter.", name, size, &p)) != 0)
+		{
+			free (c);
+			return e;
+		}
+	}
+	else if ((p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+	{
+		free (c);
+		return ENOMEM;
+	}
+	/* the first process sets the slot count, zeroed memory is otherwise ready */
+	__sync_bool_compare_and_swap (&((counter_data *) p) -> slots, 0, slots);
+	__sync_bool_compare_and_swap (&((counter_data *) p) -> magic, 0, counter_magic);
+	if (((counter_data *) p) -> magic != counter_magic || ((counter_data *) p) -> slots != (uint32_t) slots)
+	{
+		munmap (p, size);
+		free (c);
+		return EINVAL;
+	}
+	c -> d = p;
+	c -> size = size;
+	if ((e = handle_new (handle_counter, c, h)) != 0)
+	{
+		munmap (p, size);
+		free (c);
+	}
+	return e;
+}
+
+/* returns the slot of the named counter, claiming a free slot for a new name,
+   EBUSY if another process does not finish naming a slot in about 10ms */
+gtm_status_t
+posix_cslot (int argc, gtm_ulong_t h, gtm_char_t *name, gtm_int_t *slot)
+{
+	struct timespec t = { 0, 1000 };
+	counter_slot *s;
+	counter *c;
+	gtm_long_t e;
+	uint32_t i;
+	check_argc (3);
+	*slot = -1;
+	if ((c = handle_get (h, handle_counter)) == NULL || name[0] == '\0' ||
+		strchr (name, list_delimiter[0]) != NULL || strchr (name, '=') != NULL ||
+		strlen (name) >= counter_name_size)
+		return EINVAL;
+	for (i = 0; i < c -> d -> slots; i++)
+	{
+		s = c -> d -> slot + i;
+		if (s -> state == counter_free && __sync_bool_compare_and_swap (&s -> state, counter_free, counter_claiming))
+		{
+			strcpy (s -> name, name);
+			__sync_synchronize ();
+			s -> state = counter_ready;
+		}
+		/* another process is naming the slot right now */
+		for (e = 0; s -> state == counter_claiming; nanosleep (&t, NULL))
+			if (e == 0)
+				e = _posix_clock_ns (CLOCK_MONOTONIC) + counter_claim_wait;
+			else if (_posix_clock_ns (CLOCK_MONOTONIC) > e)
+				return EBUSY;
+		if (strcmp (s -> name, name) == 0)
+		{
+			*slot = i;
+			return 0;
+		}
+	}
+	return ENOSPC;
+}
+
+gtm_status_t
+posix_cinc (int argc, gtm_ulong_t h, gtm_int_t slot, gtm_long_t n)
 {
-	return _posix_link (argc, oldpath, newpath, 0);
+	counter_slot *s;
+	check_argc (3);
+	if ((s = _counter_slot (h, slot)) == NULL)
+		return EINVAL;
+	__sync_fetch_and_add (&s -> value, n);
+	return 0;
 }
 
 gtm_status_t
-posix_symlink (int argc, gtm_char_t *oldpath, gtm_char_t *newpath)
+posix_cset (int argc, gtm_ulong_t h, gtm_int_t slot, gtm_long_t v)
 {
-	return _posix_link (argc, oldpath, newpath, 1);
+	counter_slot *s;
+	check_argc (3);
+	if ((s = _counter_slot (h, slot)) == NULL)
+		return EINVAL;
+	/* aligned 64-bit stores are atomic */
+	s -> value = v;
+	__sync_synchronize ();
+	return 0;
 }
 
 gtm_status_t
-posix_unlink (int argc, gtm_char_t *path)
+posix_cget (int argc, gtm_ulong_t h, gtm_int_t slot, gtm_long_t *v)
 {
-	check_argc (1);
-	clear_errno ();
-	unlink (path);
-	return errno;
+	counter_slot *s;
+	check_argc (3);
+	*v = 0;
+	if ((s = _counter_slot (h, slot)) == NULL)
+		return EINVAL;
+	*v = s -> value;
+	return 0;
 }
 
+/* "|" joined "name=value" pairs of all the named counters */
 gtm_status_t
-posix_mkdir (int argc, gtm_char_t *path, gtm_ulong_t mode)
+posix_csnapshot (int argc, gtm_ulong_t h, gtm_char_t *snapshot /* [65536] */)
 {
+	counter_slot *s;
+	counter *c;
+	size_t l = 0;
+	uint32_t i;
+	int n;
 	check_argc (2);
-	clear_errno ();
-	mkdir (path, mode);
-	return errno;
+	snapshot[0] = '\0';
+	if ((c = handle_get (h, handle_counter)) == NULL)
+		return EINVAL;
+	for (i = 0; i < c -> d -> slots; i++)
+	{
+		s = c -> d -> slot + i;
+		if (s -> state != counter_ready)
+			continue;
+		n = snprintf (snapshot + l, 65536 - l, "%s%s=%lld", (l ? list_delimiter : ""), s -> name,
+			(long long) s -> value);
+		if (n < 0 || (size_t) n >= 65536 - l)
+		{
+			snapshot[l] = '\0';
+			return ERANGE;
+		}
+		l += n;
+	}
+	return 0;
 }
 
 gtm_status_t
-posix_rmdir (int argc, gtm_char_t *path)
+posix_cclose (int argc, gtm_ulong_t h)
 {
+	counter *c;
 	check_argc (1);
-	clear_errno ();
-	rmdir (path);
-	return errno;
+	if ((c = handle_del (h, handle_counter)) == NULL)
+		return EINVAL;
+	munmap (c -> d, c -> size);
+	free (c);
+	return 0;
 }
 
 gtm_status_t
-posix_chmod (int argc, gtm_char_t *path, gtm_ulong_t mode)
+posix_cremove (int argc, gtm_char_t *name)
 {
-	check_argc (2);
+	char b[256];
+	check_argc (1);
+	if (strchr (name, '/') != NULL || snprintf (b, sizeof (b), "/gtm-posix-counter.%s", name) >= (int) sizeof (b))
+		return EINVAL;
 	clear_errno ();
-	chmod (path, mode);
+	shm_unlink (b);
 	return errno;
 }
 
-static gtm_status_t
-_posix_chown (int argc, gtm_char_t *path, gtm_ulong_t uid, gtm_ulong_t gid, int l)
+/*
+ * Process spawning with posix_spawn(3), glibc creates the child with
+ * CLONE_VM | CLONE_VFORK, so unlike fork(2) (ZSYSTEM) the page tables of
+ * the large GT.M process (global buffers) are not copied. The child starts
+ * with the default signal dispositions and an empty signal mask, the pipe
+ * ends of the parent and all the other descriptors opened by this library
+ * are close-on-exec.
+ */
+
+/* closes fd handle *h, if any */
+static void
+_fd_drop (gtm_ulong_t *h)
 {
-	check_argc (3);
-	clear_errno ();
-	l ? lchown (path, uid, gid) : chown (path, uid, gid);
-	return errno;
+	fdesc *f;
+	if ((f = handle_del (*h, handle_fd)) != NULL)
+	{
+		close (f -> fd);
+		free (f);
+	}
+	*h = 0;
+}
+
+/* splits NUL terminated entries of s to a NULL terminated vector, free (*v) */
+static int
+_strv (gtm_string_t *s, char ***v)
+{
+	size_t i, n = 0, k = 0;
+	char *p;
+	for (i = 0; i < s -> length; i++)
+		n += s -> address[i] == '\0';
+	/* the last entry is not terminated */
+	if (s -> length && s -> address[s -> length - 1] != '\0')
+		n++;
+	if ((*v = malloc ((n + 1) * sizeof (char *) + s -> length + 1)) == NULL)
+		return ENOMEM;
+	p = (char *) (*v + n + 1);
+	memcpy (p, s -> address, s -> length);
+	p[s -> length] = '\0';
+	for (i = 0; i < n; i++)
+	{
+		(*v)[k++] = p;
+		p += strlen (p) + 1;
+	}
+	(*v)[k] = NULL;
+	return 0;
 }
 
+/*
+ * argv: NUL terminated arguments, argv[0] is the program,
+ * env: NUL terminated "name=value" entries, "" inherits the environment,
+ * in/out/err: fd handles of the parent pipe ends, 0 unless requested,
+ * pidfd: fd handle readable when the child exits, 0 unless requested or supported
+ */
 gtm_status_t
-posix_chown (int argc, gtm_char_t *path, gtm_ulong_t uid, gtm_ulong_t gid)
+posix_procspawn (int argc, gtm_string_t *args, gtm_string_t *env, gtm_char_t *spawn_name,
+	gtm_int_t *pid, gtm_ulong_t *in, gtm_ulong_t *out, gtm_ulong_t *err, gtm_ulong_t *pidfd)
 {
-	return _posix_chown (argc, path, uid, gid, 0);
+	extern char **environ;
+	posix_spawn_file_actions_t a;
+	posix_spawnattr_t at;
+	char **v = NULL, **ev = NULL;
+	int p[3][2] = { { -1, -1 }, { -1, -1 }, { -1, -1 } };
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+	sigset_t s;
+	pid_t c;
+	int spawn, e, i, fd, started;
+	check_argc (8);
+	*pid = 0;
+	*in = *out = *err = *pidfd = 0;
+	check (get_flags (spawn));
+	/* stderr goes to the stdout pipe, a stderr pipe would stay unused */
+	if ((spawn & spawn_merge) && (spawn & spawn_stderr))
+		return EINVAL;
+	if ((e = _strv (args, &v)) != 0)
+		return e;
+	if (v[0] == NULL || (env -> length && (e = _strv (env, &ev)) != 0))
+	{
+		free (v);
+		return e ? e : EINVAL;
+	}
+	posix_spawn_file_actions_init (&a);
+	posix_spawnattr_init (&at);
+	/* the child end is duplicated onto 0, 1 or 2, which clears close-on-exec */
+	for (i = 0; i < 3 && e == 0; i++)
+		if (spawn & (i == 0 ? spawn_stdin : i == 1 ? spawn_stdout : spawn_stderr))
+		{
+			if (pipe2 (p[i], O_CLOEXEC) == -1)
+				e = errno;
+			else
+				e = posix_spawn_file_actions_adddup2 (&a, p[i][i == 0 ? 0 : 1], i);
+		}
+	if (e == 0 && (spawn & spawn_merge))
+		e = posix_spawn_file_actions_adddup2 (&a, 1, 2);
+	if (spawn & spawn_setpgroup)
+		flags |= POSIX_SPAWN_SETPGROUP;
+#ifdef POSIX_SPAWN_SETSID
+	if (spawn & spawn_setsid)
+		flags |= POSIX_SPAWN_SETSID;
+#else
+	if (spawn & spawn_setsid)
+		e = ENOTSUP;
+#endif
+	sigemptyset (&s);
+	posix_spawnattr_setsigmask (&at, &s);
+	sigfillset (&s);
+	posix_spawnattr_setsigdefault (&at, &s);
+	posix_spawnattr_setflags (&at, flags);
+	if (e == 0)
+		e = (spawn & spawn_path ? posix_spawnp : posix_spawn) (&c, v[0], &a, &at, v, ev ? ev : environ);
+	started = (e == 0);
+	posix_spawn_file_actions_destroy (&a);
+	posix_spawnattr_destroy (&at);
+	free (v);
+	free (ev);
+	/* the child ends belong to the child now */
+	for (i = 0; i < 3; i++)
+		if (p[i][0] != -1)
+		{
+			close (p[i][i == 0 ? 0 : 1]);
+			fd = p[i][i == 0 ? 1 : 0];
+			if (e != 0)
+				close (fd);
+			else
+			{
+				if (spawn & spawn_nonblock)
+					fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+				e = _fd_handle (fd, i == 0 ? in : i == 1 ? out : err);
+			}
+		}
+	if (!started)
+		return e;
+	/* the child runs even if its handles could not be returned, pid lets the caller reap it */
+	*pid = c;
+#ifdef SYS_pidfd_open
+	/* not supported before Linux 5.3, the child can still be reaped by waitpid */
+	if (e == 0 && (spawn & spawn_pidfd) && (fd = syscall (SYS_pidfd_open, c, 0)) != -1)
+	{
+		fcntl (fd, F_SETFD, FD_CLOEXEC);
+		e = _fd_handle (fd, pidfd);
+	}
+#endif
+	if (e != 0)
+	{
+		/* closing the parent ends tells the child there is nobody on the other side */
+		_fd_drop (in);
+		_fd_drop (out);
+		_fd_drop (err);
+		_fd_drop (pidfd);
+	}
+	return e;
 }
 
+/* rpid: 0 when NOHANG and the child has not changed state, status: exit status, signo: terminating or stopping signal */
 gtm_status_t
-posix_lchown (int argc, gtm_char_t *path, gtm_ulong_t uid, gtm_ulong_t gid)
+posix_waitpid (int argc, gtm_int_t pid, gtm_char_t *wait_flags_name, gtm_int_t *rpid, gtm_int_t *status, gtm_int_t *signo)
 {
-	return _posix_chown (argc, path, uid, gid, 1);
+	int wait_flags, s = 0;
+	pid_t r;
+	check_argc (5);
+	*rpid = *status = *signo = 0;
+	check (get_flags (wait_flags));
+	while ((r = waitpid (pid, &s, wait_flags)) == -1)
+		if (errno != EINTR)
+			return errno;
+	*rpid = r;
+	if (r == 0)
+		return 0;
+	if (WIFEXITED (s))
+		*status = WEXITSTATUS (s);
+	else if (WIFSIGNALED (s))
+		*signo = WTERMSIG (s);
+	else if (WIFSTOPPED (s))
+		*signo = WSTOPSIG (s);
+	return 0;
 }
 
-static gtm_status_t
-_posix_getpw (int argc,
-	gtm_char_t *name,
-	gtm_ulong_t uid,
-	gtm_char_t *pw_name /* [64] */, gtm_char_t *pw_passwd /* [64] */,
-	gtm_ulong_t *pw_uid, gtm_ulong_t *pw_gid,
-	gtm_char_t *pw_gecos /* [256] */, gtm_char_t *pw_dir /* [1024] */, gtm_char_t *pw_shell /* [1024] */)
+/*
+ * Event multiplexing with epoll(7), a poll set waits on fd handles (files,
+ * pipes, pidfds, timers), watches and signal handles at once, and reports
+ * the ready handles in batches. Timers are timerfd(2) fd handles, signals
+ * are received through signalfd(2) instead of GT.M's own handlers.
+ */
+
+typedef struct
 {
-	struct passwd *b;
-	check_argc (8);
-	*pw_uid = 0;
-	*pw_gid = 0;
-	pw_name[0] = '\0';
-	pw_passwd[0] = '\0';
-	pw_gecos[0] = '\0';
-	pw_dir[0] = '\0';
-	pw_shell[0] = '\0';
+	int fd;
+	sigset_t mask;
+}
+sigdesc;
+
+/* signal handles sharing a signal, signals blocked before the first handle stay blocked */
+static struct
+{
+	int refs[_NSIG];
+	sigset_t blocked;
+}
+sig_block;
+
+typedef struct
+{
+	int fd;
+	/* watches buffer events read from inotify, these are ready without the fd */
+	gtm_ulong_t *watch;
+	size_t nwatch;
+	size_t size;
+}
+poller;
+
+/* the event names reported back, in the order they are listed */
+static const param poll_event[] = {
+	{ "IN",		EPOLLIN },
+	{ "PRI",	EPOLLPRI },
+	{ "OUT",	EPOLLOUT },
+	{ "RDHUP",	EPOLLRDHUP },
+	{ "ERR",	EPOLLERR },
+	{ "HUP",	EPOLLHUP }
+};
+
+/* descriptor of fd, watch or signal handle, -1 for other handles */
+static int
+_handle_fd (gtm_ulong_t h)
+{
+	fdesc *f;
+	watcher *w;
+	sigdesc *d;
+	if ((f = handle_get (h, handle_fd)) != NULL)
+		return f -> fd;
+	if ((w = handle_get (h, handle_watch)) != NULL)
+		return w -> fd;
+	if ((d = handle_get (h, handle_signal)) != NULL)
+		return d -> fd;
+	return -1;
+}
+
+gtm_status_t
+posix_epcreate (int argc, gtm_ulong_t *h)
+{
+	poller *p;
+	int e;
+	check_argc (1);
+	*h = 0;
+	if ((p = calloc (1, sizeof (poller))) == NULL)
+		return ENOMEM;
 	clear_errno ();
-	if ((b = (name == NULL ? getpwuid (uid) : getpwnam (name))) != NULL)
+	if ((p -> fd = epoll_create1 (EPOLL_CLOEXEC)) == -1)
 	{
-		*pw_uid = b -> pw_uid;
-		*pw_gid = b -> pw_gid;
-		if (strncopy (pw_name, b -> pw_name, 64) ||
-			strncopy (pw_passwd, b -> pw_passwd, 64) ||
-			strncopy (pw_gecos, b -> pw_gecos, 256) ||
-			strncopy (pw_dir, b -> pw_dir, 1024) ||
-			strncopy (pw_shell, b -> pw_shell, 1024))
-				return ERANGE;
+		free (p);
+		return errno;
 	}
-	else
+	if ((e = handle_new (handle_poll, p, h)) != 0)
 	{
-		/*
-		 * This the case:
-		 *   "The given name or uid was not found."
-		 * so errno should get
-		 *   "0 or ENOENT or ESRCH or EBADF or EPERM or ..."
-		 * but it doesn't (libc 2.13-26), so it must be set manually
-		 *
-		 */
-		errno = ENOENT;
+		close (p -> fd);
+		free (p);
 	}
-	return errno;
+	return e;
 }
 
+/* adds h to the set or changes its events, "IN" by default */
 gtm_status_t
-posix_getpwnam (int argc,
-	gtm_char_t *name,
-	gtm_char_t *pw_name /* [64] */, gtm_char_t *pw_passwd /* [64] */,
-	gtm_ulong_t *pw_uid, gtm_ulong_t *pw_gid,
-	gtm_char_t *pw_gecos /* [256] */, gtm_char_t *pw_dir /* [1024] */, gtm_char_t *pw_shell /* [1024] */)
+posix_epctl (int argc, gtm_ulong_t ph, gtm_ulong_t h, gtm_char_t *poll_events_name)
 {
-	return _posix_getpw (argc, name, 0, pw_name, pw_passwd, pw_uid, pw_gid, pw_gecos, pw_dir, pw_shell);
+	struct epoll_event ev;
+	gtm_ulong_t *w;
+	poller *p;
+	int poll_events, fd;
+	size_t i;
+	check_argc (3);
+	check (get_flags (poll_events));
+	if ((p = handle_get (ph, handle_poll)) == NULL || (fd = _handle_fd (h)) == -1)
+		return EINVAL;
+	ev.events = poll_events ? (uint32_t) poll_events : EPOLLIN;
+	ev.data.u64 = h;
+	if (epoll_ctl (p -> fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+	{
+		if (errno != EEXIST)
+			return errno;
+		if (epoll_ctl (p -> fd, EPOLL_CTL_MOD, fd, &ev) == -1)
+			return errno;
+		return 0;
+	}
+	if (handle_get (h, handle_watch) == NULL)
+		return 0;
+	for (i = 0; i < p -> nwatch && p -> watch[i] != h; i++)
+		;
+	if (i == p -> nwatch)
+	{
+		if (p -> nwatch == p -> size)
+		{
+			if ((w = realloc (p -> watch, (p -> size ? p -> size * 2 : 16) * sizeof (gtm_ulong_t))) == NULL)
+			{
+				epoll_ctl (p -> fd, EPOLL_CTL_DEL, fd, &ev);
+				return ENOMEM;
+			}
+			p -> watch = w;
+			p -> size = p -> size ? p -> size * 2 : 16;
+		}
+		p -> watch[p -> nwatch++] = h;
+	}
+	return 0;
 }
 
 gtm_status_t
-posix_getpwuid (int argc,
-	gtm_ulong_t uid,
-	gtm_char_t *pw_name /* [64] */, gtm_char_t *pw_passwd /* [64] */,
-	gtm_ulong_t *pw_uid, gtm_ulong_t *pw_gid,
-	gtm_char_t *pw_gecos /* [256] */, gtm_char_t *pw_dir /* [1024] */, gtm_char_t *pw_shell /* [1024] */)
+posix_epdel (int argc, gtm_ulong_t ph, gtm_ulong_t h)
 {
-	return _posix_getpw (argc, NULL, uid, pw_name, pw_passwd, pw_uid, pw_gid, pw_gecos, pw_dir, pw_shell);
+	struct epoll_event ev;
+	poller *p;
+	size_t i;
+	int fd;
+	check_argc (2);
+	if ((p = handle_get (ph, handle_poll)) == NULL)
+		return EINVAL;
+	for (i = 0; i < p -> nwatch; i++)
+		if (p -> watch[i] == h)
+			p -> watch[i--] = p -> watch[--p -> nwatch];
+	/* closed fds are removed from the set by the kernel */
+	if ((fd = _handle_fd (h)) == -1)
+		return 0;
+	clear_errno ();
+	epoll_ctl (p -> fd, EPOLL_CTL_DEL, fd, &ev);
+	return errno;
 }
 
-static gtm_status_t
-_posix_getgr (int argc,
-	gtm_char_t *name,
-	gtm_ulong_t gid,
-	gtm_char_t *gr_name /* [64] */, gtm_char_t *gr_passwd /* [64] */,
-	gtm_ulong_t *gr_gid, gtm_char_t *gr_mem /* [4096] */)
+/* appends "h|events" record to the ready list, returns 0 if it does not fit */
+static int
+_epoll_record (char *ready, size_t *l, gtm_ulong_t h, uint32_t events)
 {
-	struct group *g;
-	int i;
-	ssize_t l;
-	char *p;
+	char r[128];
+	size_t i, k;
+	k = snprintf (r, sizeof (r), "%lu|", (unsigned long) h);
+	for (i = 0; i < sizeof (poll_event) / sizeof (param); i++)
+		if (events & poll_event[i].value)
+			k += snprintf (r + k, sizeof (r) - k, "%s%s", (r[k - 1] == '|' ? "" : ","), poll_event[i].name);
+	if (*l + (*l != 0) + k >= 65536)
+		return 0;
+	if (*l != 0)
+		ready[(*l)++] = name_delimiter[0];
+	memcpy (ready + *l, r, k + 1);
+	*l += k;
+	return 1;
+}
+
+/*
+ * Waits up to timeout milliseconds (-1 forever) for at most max (1024 by
+ * default) ready handles and returns them as "/" separated "h|events"
+ * records, events are "," joined names. n is set to 0 on timeout or when
+ * interrupted by a signal.
+ */
+gtm_status_t
+posix_epwait (int argc, gtm_ulong_t ph, gtm_int_t max, gtm_int_t timeout, gtm_char_t *ready /* [65536] */,
+	gtm_int_t *n)
+{
+	struct epoll_event ev[1024];
+	watcher *w;
+	poller *p;
+	size_t i, l = 0;
+	int k;
 	check_argc (5);
-	*gr_gid = 0;
-	gr_name[0] = '\0';
-	gr_passwd[0] = '\0';
-	gr_mem[0] = '\0';
-	clear_errno ();
-	if ((g = (name == NULL) ? getgrgid (gid) : getgrnam (name)) != NULL)
+	ready[0] = '\0';
+	*n = 0;
+	if ((p = handle_get (ph, handle_poll)) == NULL || max < 0)
+		return EINVAL;
+	if (max == 0 || max > 1024)
+		max = 1024;
+	/* buffered watch events first, then only the kernel events already pending */
+	for (i = 0; i < p -> nwatch; i++)
 	{
-		*gr_gid = g -> gr_gid;
-		if (strncopy (gr_name, g -> gr_name, 64) ||
-			strncopy(gr_passwd, g -> gr_passwd, 64))
-				return ERANGE;
-
-		p = gr_mem; 
-		l = 4096;
-		for (i = 0; g -> gr_mem[i] != NULL; i++)
+		if ((w = handle_get (p -> watch[i], handle_watch)) == NULL)
 		{
-			if (i > 0)
-				if ((p = strpncopy (p, list_delimiter, &l)) == NULL)
-					return ERANGE;
-			if ((p = strpncopy (p, g -> gr_mem[i], &l)) == NULL)
-				return ERANGE;
+			p -> watch[i--] = p -> watch[--p -> nwatch];
+			continue;
+		}
+		if (w -> off < w -> len && *n < max)
+		{
+			if (!_epoll_record (ready, &l, p -> watch[i], EPOLLIN))
+				return 0;
+			(*n)++;
+			timeout = 0;
 		}
 	}
-	else
+	if (*n == max)
+		return 0;
+	if ((k = epoll_wait (p -> fd, ev, max - *n, timeout)) == -1)
+		return errno == EINTR ? 0 : errno;
+	for (i = 0; i < (size_t) k; i++)
 	{
-		errno = ENOENT;
+		/* already reported from its buffer */
+		if ((w = handle_get (ev[i].data.u64, handle_watch)) != NULL && w -> off < w -> len)
+			continue;
+		/* level triggered events are reported again by the next call */
+		if (!_epoll_record (ready, &l, ev[i].data.u64, ev[i].events))
+			break;
+		(*n)++;
 	}
-	return errno;
+	return 0;
 }
 
 gtm_status_t
-posix_getgrnam (int argc,
-	gtm_char_t *name,
-	gtm_char_t *gr_name /* [64] */, gtm_char_t *gr_passwd /* [64] */,
-	gtm_ulong_t *gr_gid, gtm_char_t *gr_mem /* [4096] */)
+posix_epclose (int argc, gtm_ulong_t h)
 {
-	return _posix_getgr (argc, name, 0, gr_name, gr_passwd, gr_gid, gr_mem);
+	poller *p;
+	check_argc (1);
+	if ((p = handle_del (h, handle_poll)) == NULL)
+		return EINVAL;
+	close (p -> fd);
+	free (p -> watch);
+	free (p);
+	return 0;
 }
 
-gtm_status_t
-posix_getgrgid (int argc,
-	gtm_ulong_t gid,
-	gtm_char_t *gr_name /* [64] */, gtm_char_t *gr_passwd /* [64] */,
-	gtm_ulong_t *gr_gid, gtm_char_t *gr_mem /* [4096] */)
+static int
+_timer_set (int fd, gtm_long_t initial, gtm_long_t interval)
 {
-	return _posix_getgr (argc, NULL, gid, gr_name, gr_passwd, gr_gid, gr_mem);
+	struct itimerspec t;
+	if (initial < 0 || interval < 0)
+		return EINVAL;
+	/* 0 initial expiration disarms the timer */
+	if (initial == 0)
+		initial = interval;
+	t.it_value.tv_sec = initial / 1000000000;
+	t.it_value.tv_nsec = initial % 1000000000;
+	t.it_interval.tv_sec = interval / 1000000000;
+	t.it_interval.tv_nsec = interval % 1000000000;
+	clear_errno ();
+	timerfd_settime (fd, 0, &t, NULL);
+	return errno;
 }
 
-/* BSD getgrouplist like function (non-POSIX) */
+/* initial, interval: nanoseconds, 0 initial expires first after interval, 0 interval is one shot */
 gtm_status_t
-posix_getgrouplist (int argc, gtm_char_t *name, gtm_char_t *list /* [4096] */)
+posix_timer (int argc, gtm_char_t *clk_id_name, gtm_long_t initial, gtm_long_t interval, gtm_ulong_t *h)
 {
-	struct group *b;
-	int i;
-	ssize_t l = 4096;
-	char *p = list;
-	int found = 0;
+	int clk_id, fd, e;
+	check_argc (4);
+	*h = 0;
+	check (get_param (clk_id));
 	clear_errno ();
-	list[0] = '\0';
-	while ((b = getgrent ()) != NULL)
+	if ((fd = timerfd_create (clk_id, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+		return errno;
+	if ((e = _timer_set (fd, initial, interval)) != 0)
 	{
-		for (i = 0; b -> gr_mem[i] != NULL; i++)
-			if (strcmp (b -> gr_mem[i], name) == 0)
-			{
-				if (found)
-				{
-					if ((p = strpncopy (p, list_delimiter, &l)) == NULL)
-					{
-						endgrent ();
-						return ERANGE;
-					}
-				}
-				else
-					found++;
-				if ((p = strpncopy (p, b -> gr_name, &l)) == NULL)
-				{
-					endgrent ();
-					return ERANGE;
-				}
-			}
+		close (fd);
+		return e;
 	}
-	endgrent ();
-	return errno;
+	return _fd_handle (fd, h);
 }
 
-#define dir_limit 256
-static DIR *dir_list[dir_limit];
-static int dir_count = 0;
+/* rearms the timer, 0 initial and 0 interval disarm it */
+gtm_status_t
+posix_timerset (int argc, gtm_ulong_t h, gtm_long_t initial, gtm_long_t interval)
+{
+	fdesc *f;
+	check_argc (3);
+	if ((f = _fd_get (h)) == NULL)
+		return EINVAL;
+	return _timer_set (f -> fd, initial, interval);
+}
 
-#define push_dir(x) push_list ((void *) x, dir_list, dir_count)
-#define check_dir() check_list (dir_count, dir_limit)
-#define is_dir(x,y) in_list ((void *) x, (void **)dir_list, &dir_count, y)
+/* count: number of expirations since the last call, 0 if none */
+gtm_status_t
+posix_timerread (int argc, gtm_ulong_t h, gtm_long_t *count)
+{
+	uint64_t c;
+	fdesc *f;
+	check_argc (2);
+	*count = 0;
+	if ((f = _fd_get (h)) == NULL)
+		return EINVAL;
+	if (read (f -> fd, &c, sizeof (c)) == -1)
+		return (errno == EAGAIN || errno == EINTR) ? 0 : errno;
+	*count = c;
+	return 0;
+}
 
+/* blocks the signals, so they are queued to the handle instead of delivered to GT.M */
 gtm_status_t
-posix_opendir (int argc, gtm_char_t *path, gtm_ulong_t *dir)
+posix_sigopen (int argc, gtm_char_t *signo_name, gtm_ulong_t *h)
 {
-	DIR *b;
+	const char *p = signo_name, *q;
+	sigset_t old;
+	sigdesc *d;
+	int signo, e;
 	check_argc (2);
-	check_dir ();
+	*h = 0;
+	if ((d = malloc (sizeof (sigdesc))) == NULL)
+		return ENOMEM;
+	sigemptyset (&d -> mask);
+	/* signals are not bit flags, so get_flags does not apply */
+	for (; *p != '\0'; p = *q ? q + 1 : q)
+	{
+		q = p + strcspn (p, list_delimiter);
+		if (_get_param_n (signo_param, sizeof (signo_param) / sizeof (param), p, q - p, &signo) != 0)
+		{
+			free (d);
+			return EINVAL;
+		}
+		sigaddset (&d -> mask, signo);
+	}
+	if (p == signo_name)
+	{
+		free (d);
+		return EINVAL;
+	}
 	clear_errno ();
-	if ((b = opendir (path)) != NULL)
+	if ((d -> fd = signalfd (-1, &d -> mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)
 	{
-		*dir = (gtm_ulong_t) b;
-		push_dir (b);
+		e = errno;
+		free (d);
+		return e;
 	}
-	return errno;
+	if ((e = handle_new (handle_signal, d, h)) != 0)
+	{
+		close (d -> fd);
+		free (d);
+		return e;
+	}
+	sigprocmask (SIG_BLOCK, &d -> mask, &old);
+	for (signo = 1; signo < _NSIG; signo++)
+		if (sigismember (&d -> mask, signo) == 1 && sig_block.refs[signo]++ == 0)
+		{
+			if (sigismember (&old, signo) == 1)
+				sigaddset (&sig_block.blocked, signo);
+			else
+				sigdelset (&sig_block.blocked, signo);
+		}
+	return 0;
 }
 
+/* signo: number of the received signal, 0 if none, pid: sender */
 gtm_status_t
-posix_readdir (int argc, gtm_ulong_t dir, gtm_char_t *name /* [256] */)
+posix_sigread (int argc, gtm_ulong_t h, gtm_int_t *signo, gtm_int_t *pid)
 {
-	struct dirent *b;
-	check_argc (2);
-	name[0] = '\0';
-	if (!is_dir (dir, 0))
+	struct signalfd_siginfo i;
+	sigdesc *d;
+	check_argc (3);
+	*signo = *pid = 0;
+	if ((d = handle_get (h, handle_signal)) == NULL)
 		return EINVAL;
-	clear_errno ();
-	if ((b = readdir ((DIR *) dir)) != NULL)
-		if (strncopy (name, b -> d_name, 256))
-			return ERANGE;
-	return errno;
+	if (read (d -> fd, &i, sizeof (i)) == -1)
+		return (errno == EAGAIN || errno == EINTR) ? 0 : errno;
+	*signo = i.ssi_signo;
+	*pid = i.ssi_pid;
+	return 0;
 }
 
+/* unblocks the signals no other handle uses, pending ones are delivered to GT.M */
 gtm_status_t
-posix_closedir (int argc, gtm_ulong_t dir)
+posix_sigclose (int argc, gtm_ulong_t h)
 {
+	sigset_t m;
+	sigdesc *d;
+	int signo;
 	check_argc (1);
-	if (!is_dir (dir, 1))
+	if ((d = handle_del (h, handle_signal)) == NULL)
 		return EINVAL;
-	closedir ((DIR *) dir);
-	return errno;
+	close (d -> fd);
+	sigemptyset (&m);
+	for (signo = 1; signo < _NSIG; signo++)
+		if (sigismember (&d -> mask, signo) == 1 && --sig_block.refs[signo] == 0 &&
+			sigismember (&sig_block.blocked, signo) != 1)
+				sigaddset (&m, signo);
+	sigprocmask (SIG_UNBLOCK, &m, NULL);
+	free (d);
+	return 0;
 }
-
@@ -25,10 +25,12 @@
 
 
 ;
-; Non-zero errno will raise an exception in all routines except stat and lstat.
+; Non-zero errno will raise an exception in all routines except stat, lstat,
+; trymkpath, tryrmpath and walk.
 ;
 ; stat and lstat does not raise an exception to let the M code stay clear when
-; the tests for file/directory existence are concerned.
+; the tests for file/directory existence are concerned, trymkpath, tryrmpath
+; and walk return the path which failed along with errno.
 ;
 ; This behaviour can be modified by changing function types in posix.xc file:
 ; 1) "gtm_status_t" to "gtm_int_t" to disable raising the exception,
@@ -46,6 +48,26 @@ strerror(e) ; MUMPS-ish version
 	q $s(e:$zm(e),1:"")
 
 
+; Options
+
+; s err=$$param^posix("priority","ERR")
+; f i=1:1:1000 d syslog^posix("message "_i,err)
+;
+result(len) ; returns len bytes long result of the last "x" call, see RESULTS in posix.c
+	n r,s,o
+	s r="",o=0
+	f  q:o'<len  s errno=$&posix.fetch(o,len-o,.s) q:s=""  s r=r_s,o=o+$zl(s)
+	q r
+
+param(table,name) ; returns integer token for stringified option names, which can be passed instead of the names
+	; table: "advice", "clock", "copyfile", "facility", "mempolicy", "mmap", "open", "option", "poll", "policy",
+	;	"priority", "rusage", "scandir", "signal", "spawn", "statx", "tz", "wait", "watch" or "which"
+	;	(case insensitive)
+	n value
+	s errno=$&posix.param(.table,.name,.value)
+	q value
+
+
 ; Time
 
 ; w $$time^posix
@@ -71,15 +93,38 @@ gmtime(n,t) ; same as localtime() but in UTC (not localized)
 ; zwr
 ;
 clktime(clkid,sec,nsec) ; better gettimeofday
-	; clkid: "REALTIME", "MONOTONIC", "MONOTONIC_RAW", "PROCESS_CPUTIME_ID" or "THREAD_CPUTIME_ID" (case insensitive)
+	; clkid: "REALTIME", "REALTIME_COARSE", "MONOTONIC", "MONOTONIC_COARSE", "MONOTONIC_RAW",
+	;	"PROCESS_CPUTIME_ID" or "THREAD_CPUTIME_ID" (case insensitive)
 	s errno=$&posix.clockgettime(.clkid,.sec,.nsec)
 	q
 
 clkres(clkid,sec,nsec)
-	; clkid: "REALTIME", "MONOTONIC", "MONOTONIC_RAW", "PROCESS_CPUTIME_ID" or "THREAD_CPUTIME_ID" (case insensitive)
+	; clkid: "REALTIME", "REALTIME_COARSE", "MONOTONIC", "MONOTONIC_COARSE", "MONOTONIC_RAW",
+	;	"PROCESS_CPUTIME_ID" or "THREAD_CPUTIME_ID" (case insensitive)
 	s errno=$&posix.clockgetres(.clkid,.sec,.nsec)
 	q
 
+; s t=$$monons^posix
+; ...
+; w $$monons^posix-t," ns",!
+;
+monons() ; returns CLOCK_MONOTONIC in nanoseconds
+	q $&posix.monons()
+
+realns() ; returns CLOCK_REALTIME (unix time) in nanoseconds, as a string of 19 digits, which is exact
+	; while GT.M numbers keep 18 digits only, use $e(ns,1,$l(ns)-9) and $e(ns,$l(ns)-8,$l(ns)) for arithmetic
+	n ns
+	d &posix.realns(.ns)
+	q ns
+
+monocns() ; CLOCK_MONOTONIC_COARSE, faster but with resolution of a tick, see clkres
+	q $&posix.monocns()
+
+realcns() ; CLOCK_REALTIME_COARSE, a string like realns
+	n ns
+	d &posix.realcns(.ns)
+	q ns
+
 ; d localtime^posix(.n)
 ; w $$strftime^posix("%T %F",.n)
 ;
@@ -88,6 +133,43 @@ strftime(fmt,n) ; returns formated date
 	s errno=$&posix.strftime(.fmt,n("sec"),n("min"),n("hour"),n("mday"),n("mon"),n("year"),n("wday"),n("yday"),n("isdst"),.s)
 	q s
 
+; w $$formattime^posix("%F %T %z")
+; w $$formattime^posix("%F %T",$$time^posix-3600,"UTC")
+;
+formattime(fmt,t,tz) ; returns formated date, like strftime without intermediate localtime
+	; t: unix time (optional, current time by default)
+	; tz: "LOCAL" or "UTC" (case insensitive, optional, "LOCAL" by default)
+	n s
+	s errno=$&posix.formattime(.fmt,$g(t,$$time),$g(tz,"LOCAL"),.s)
+	q s
+
+; w $$strftimev^posix("%F %T","1700000000|1700000060|1700003600")
+; w $$localtimev^posix("1700000000|1700086400")
+; w $$mktimev^posix($h_"|"_($h-1))
+;
+; vectorized conversions of "|" joined lists, results are "|" joined (in the same order)
+strftimev(fmt,list,tz) ; formats unix times, see formattime
+	n r,s,o,i
+	s r="",i=0
+	f  s errno=$&posix.strftimev(.fmt,.list,$g(tz,"LOCAL"),.o,.s) s r=r_$s(i:"|",1:"")_s,i=1,list=$e(list,o+1,$l(list)) q:list=""
+	q r
+
+localtimev(list,tz) ; converts unix times to $H format
+	n r,s,o,i
+	s r="",i=0
+	f  s errno=$&posix.localtimev(.list,$g(tz,"LOCAL"),.o,.s) s r=r_$s(i:"|",1:"")_s,i=1,list=$e(list,o+1,$l(list)) q:list=""
+	q r
+
+mktimev(list,tz) ; converts $H format dates to unix times
+	n r,s,o,i
+	s r="",i=0
+	f  s errno=$&posix.mktimev(.list,$g(tz,"LOCAL"),.o,.s) s r=r_$s(i:"|",1:"")_s,i=1,list=$e(list,o+1,$l(list)) q:list=""
+	q r
+
+tzset() ; reloads TZ rules, e.g. after the time zone database update, setenv^posix("TZ",...) calls it
+	d &posix.tzset()
+	q
+
 ; d localtime^posix(.n)
 ; w $$mktime^posix(.n)
 ;
@@ -95,6 +177,103 @@ mktime(n) ; returns unix time
 	q $&posix.mktime(n("sec"),n("min"),n("hour"),n("mday"),n("mon"),n("year"),n("wday"),n("yday"),n("isdst"))
 
 
+; Histograms
+
+; s h=$$hcreate^posix
+; f i=1:1:1000 s t=$$monons^posix d work,hrecord^posix(h,$$monons^posix-t)
+; w $$hpercentile^posix(h,50)," ",$$hpercentile^posix(h,99.9),!
+; d hstat^posix(h,.n) zwr n
+; d hclose^posix(h)
+;
+hcreate(name) ; returns histogram handle, named histograms live in shared memory
+	; name: optional, histograms of the same name are shared by all the processes
+	n h
+	s errno=$&posix.hcreate($g(name),.h)
+	q h
+
+hrecord(h,ns) ; records a value, e.g. latency in nanoseconds
+	d &posix.hrecord(.h,.ns)
+	q
+
+hpercentile(h,p) ; returns value at percentile p (0-100, e.g. 99.9), with relative error less than 1/128
+	n v
+	s errno=$&posix.hpercentile(.h,p,.v)
+	q v
+
+hstat(h,n) ; n: "count", "sum", "min", "max" and "mean" of recorded values
+	n count,sum,min,max
+	k n
+	s errno=$&posix.hstat(.h,.count,.sum,.min,.max)
+	s:'errno n("count")=count,n("sum")=sum,n("min")=min,n("max")=max,n("mean")=$s(count:sum/count,1:0)
+	q
+
+hdump(h) ; returns "|" joined "value:count" pairs of non-empty buckets, value is the highest value of the bucket
+	n s
+	s errno=$&posix.hdump(.h,.s)
+	q s
+
+hreset(h)
+	s errno=$&posix.hreset(.h)
+	q
+
+hclose(h)
+	s errno=$&posix.hclose(.h)
+	q
+
+hremove(name) ; removes named histogram shared memory object
+	s errno=$&posix.hremove(.name)
+	q
+
+
+; Counters
+
+; s h=$$ccreate^posix("app"),s=$$cslot^posix(h,"requests")
+; d cinc^posix(h,s) w $$cget^posix(h,s),!
+; d csnapshot^posix(h,.n) zwr n
+; d cclose^posix(h)
+;
+ccreate(name,slots) ; returns counter handle, named counters live in shared memory
+	; name: optional, counters of the same name are shared by all the processes
+	; slots: optional, number of counters, 1024 by default
+	n h
+	s errno=$&posix.ccreate($g(name),+$g(slots),.h)
+	q h
+
+cslot(h,name) ; returns slot of the named counter, claims a free slot for a new name
+	; raises EBUSY when a process died while naming a slot
+	n s
+	s errno=$&posix.cslot(.h,.name,.s)
+	q s
+
+cinc(h,s,n) ; adds n (1 by default) to the counter in slot s
+	d &posix.cinc(.h,.s,$g(n,1))
+	q
+
+cset(h,s,v) ; sets the gauge in slot s
+	d &posix.cset(.h,.s,.v)
+	q
+
+cget(h,s) ; returns value of slot s
+	n v
+	s errno=$&posix.cget(.h,.s,.v)
+	q v
+
+csnapshot(h,n) ; n(name): value of all the named counters
+	n s,i,p
+	k n
+	s errno=$&posix.csnapshot(.h,.s)
+	f i=1:1:$l(s,"|") s p=$p(s,"|",i) s:p'="" n($p(p,"=",1))=$p(p,"=",2)
+	q
+
+cclose(h)
+	s errno=$&posix.cclose(.h)
+	q
+
+cremove(name) ; removes named counter shared memory object
+	s errno=$&posix.cremove(.name)
+	q
+
+
 ; Environment
 
 setenv(name,value,overwrite)
@@ -106,6 +285,27 @@ unsetenv(name)
 	d &posix.unsetenv(.name)
 	q
 
+environ(n) ; n(name): value of all the environment variables
+	n l,e,i,p
+	k n
+	s errno=$&posix.environx(.l) q:errno
+	s e=$$result(l)
+	f i=1:1:$l(e,$c(0))-1 s p=$p(e,$c(0),i) s:p'="" n($p(p,"=",1))=$p(p,"=",2,$l(p,"="))
+	q
+
+setenvs(n,overwrite) ; sets environment variables n(name)=value in one call
+	; overwrite is optional
+	n e
+	s e=$$envpack(.n)
+	s errno=$&posix.setenvs(.e,$g(overwrite,1))
+	q
+
+envpack(n) ; returns n(name)=value array packed for setenvs and spawn
+	n e,k
+	s e="",k=""
+	f  s k=$o(n(k)) q:k=""  s e=e_k_"="_n(k)_$c(0)
+	q e
+
 
 ; System
 
@@ -123,6 +323,43 @@ sysinfo(n) ; Load Average, memory, etc.
 	s:'errno n("load1")=load1,n("load5")=load5,n("load15")=load15,n("totalram")=totalram,n("freeram")=freeram,n("sharedram")=sharedram,n("bufferram")=bufferram,n("totalswap")=totalswap,n("freeswap")=freeswap,n("procs")=procs,n("totalhigh")=totalhigh,n("freehigh")=freehigh,n("unit")=unit
 	q
 
+; d rusage^posix(.n) zwr n
+;
+rusage(n,who) ; resource usage, "utime" and "stime" in microseconds, "maxrss" in kilobytes
+	; who: "SELF", "THREAD" or "CHILDREN" (case insensitive, optional, "SELF" by default)
+	n utime,stime,maxrss,minflt,majflt,nvcsw,nivcsw,inblock,oublock
+	k n
+	s errno=$&posix.getrusage($g(who,"SELF"),.utime,.stime,.maxrss,.minflt,.majflt,.nvcsw,.nivcsw,.inblock,.oublock)
+	s:'errno n("utime")=utime,n("stime")=stime,n("maxrss")=maxrss,n("minflt")=minflt,n("majflt")=majflt,n("nvcsw")=nvcsw,n("nivcsw")=nivcsw,n("inblock")=inblock,n("oublock")=oublock
+	q
+
+procio(n) ; non-POSIX (Linux), I/O counters of the process, see proc(5)
+	n rchar,wchar,syscr,syscw,rbytes,wbytes,cbytes
+	k n
+	s errno=$&posix.procio(.rchar,.wchar,.syscr,.syscw,.rbytes,.wbytes,.cbytes)
+	s:'errno n("rchar")=rchar,n("wchar")=wchar,n("syscr")=syscr,n("syscw")=syscw,n("read_bytes")=rbytes,n("write_bytes")=wbytes,n("cancelled_write_bytes")=cbytes
+	q
+
+statm(n) ; non-POSIX (Linux), memory usage of the process in bytes
+	n size,resident,shared,text,data
+	k n
+	s errno=$&posix.statm(.size,.resident,.shared,.text,.data)
+	s:'errno n("size")=size,n("resident")=resident,n("shared")=shared,n("text")=text,n("data")=data
+	q
+
+; f  d metrics^posix(.n) w n("cpu.user")," ",$g(n("disk.sda.util")),! h 10
+;
+metrics(n,truncated) ; non-POSIX (Linux), node metrics, rates since the previous call (per second, CPU and disk "util" in percent)
+	; "load1", "load5", "load15", "cpu.user", "cpu.system", "cpu.idle", "cpu.iowait", "cpu.steal", "ctxt.ps",
+	; "procs.running", "procs.blocked", "disk.<dev>.rps", ".rkbs", ".wps", ".wkbs", ".util",
+	; "net.<if>.rxbs", ".rxpps", ".txbs", ".txpps" and "psi.<cpu|io|memory>.<some|full>.avg10", ".avg60", ".avg300"
+	; truncated: optional, 1 when some of the metrics did not fit (many disks or interfaces)
+	n s,i,r
+	k n
+	s errno=$&posix.metrics(.s,.truncated)
+	f i=1:1:$l(s,"|") s r=$p(s,"|",i) s:r'="" n($p(r,"="))=$p(r,"=",2)
+	q
+
 uname(n)
 	n sysname,nodename,release,version,machine
 	s errno=$&posix.uname(.sysname,.nodename,.release,.version,.machine)
@@ -130,6 +367,162 @@ uname(n)
 	q
 
 
+; Processes
+
+; s argv(1)="sort",argv(2)="-u"
+; d spawn^posix(.argv,,.pid,.fds,"PATH|STDIN|STDOUT")
+; s w=$$write^posix(fds("stdin"),"b"_$c(10)_"a"_$c(10)) d close^posix(fds("stdin"))
+; f  s s=$$read^posix(fds("stdout"),65536,.eof) q:eof  w s
+; d close^posix(fds("stdout")),waitpid^posix(pid,.n) zwr n
+;
+spawn(argv,env,pid,fds,flags) ; starts argv(1) with arguments argv(2), ... without forking GT.M process
+	; env: optional, env(name)=value environment of the child, the environment is inherited by default
+	; pid: set even when the child started but its handles could not be created, so it can be reaped
+	; fds: "stdin", "stdout", "stderr" pipe fd handles and "pidfd" fd handle readable at the child exit
+	; flags: "|" joined "STDIN", "STDOUT", "STDERR" (pipes), "MERGE" (stderr to stdout), "NONBLOCK" (pipes),
+	;	"PATH" (searches PATH for argv(1)), "PIDFD", "SETPGROUP" or "SETSID" (case insensitive, optional),
+	;	"MERGE" and "STDERR" exclude each other
+	n a,e,i,in,out,err,pidfd
+	s a="",i=""
+	f  s i=$o(argv(i)) q:i=""  s a=a_argv(i)_$c(0)
+	s e=$$envpack(.env)
+	k fds
+	s errno=$&posix.spawn(.a,.e,$g(flags),.pid,.in,.out,.err,.pidfd)
+	s:in fds("stdin")=in s:out fds("stdout")=out s:err fds("stderr")=err s:pidfd fds("pidfd")=pidfd
+	q
+
+waitpid(pid,n,flags) ; n: "pid" (0 if "NOHANG" and still running), "status" (exit status) and "signal"
+	; flags: "|" joined "NOHANG", "UNTRACED" or "CONTINUED" (case insensitive, optional)
+	n r,status,signal
+	k n
+	s errno=$&posix.waitpid(pid,$g(flags),.r,.status,.signal)
+	s n("pid")=r,n("status")=status,n("signal")=signal
+	q
+
+
+; Events
+
+; s p=$$pcreate^posix
+; d timer^posix(.t,1E9,1E9),pset^posix(p,t),sigopen^posix("TERM|HUP",.s),pset^posix(p,s)
+; f  s n=$$poll^posix(p,-1,.ready) s h="" f  s h=$o(ready(h)) q:h=""  d dispatch(h,ready(h))
+;
+pcreate() ; returns poll set handle
+	n p
+	s errno=$&posix.pcreate(.p)
+	q p
+
+pset(p,h,events) ; adds fd, watch or signal handle h to the poll set p or changes its events
+	; events: "|" joined "IN", "OUT", "PRI", "RDHUP", "ERR", "HUP", "ET" or "ONESHOT" (case insensitive,
+	;	optional, "IN" by default)
+	s errno=$&posix.pset(.p,.h,$g(events))
+	q
+
+punset(p,h) ; removes h from the poll set, closed handles are removed automatically
+	s errno=$&posix.punset(.p,.h)
+	q
+
+poll(p,timeout,ready,max) ; ready(h): "," joined events of ready handles, returns their count
+	; timeout: milliseconds, -1 waits forever, ready is empty on timeout
+	; max: optional, at most max (1024 by default) handles in one call
+	n r,n,i,s
+	k ready
+	s errno=$&posix.pwait(.p,+$g(max),.timeout,.r,.n)
+	f i=1:1:n s s=$p(r,"/",i),ready($p(s,"|",1))=$p(s,"|",2)
+	q n
+
+pclose(p)
+	s errno=$&posix.pclose(.p)
+	q
+
+timer(t,initial,interval,clock) ; t: fd handle readable when the timer expires, see pset
+	; initial: nanoseconds to the first expiration, 0 means interval
+	; interval: nanoseconds between expirations, 0 for one shot timer
+	; clock: optional, "MONOTONIC" by default or "REALTIME", see clockgettime
+	s errno=$&posix.timer($g(clock,"MONOTONIC"),.initial,+$g(interval),.t)
+	q
+
+timerset(t,initial,interval) ; rearms the timer t, 0 initial and interval disarm it
+	s errno=$&posix.timerset(.t,.initial,+$g(interval))
+	q
+
+timerread(t) ; returns number of expirations since the last call, 0 if none
+	n c
+	s errno=$&posix.timerread(.t,.c)
+	q c
+
+sigopen(signals,s) ; s: signal handle, the signals are blocked and queued to s instead, see pset
+	; signals: "|" joined "CHLD", "CONT", "HUP", "INT", "PIPE", "QUIT", "TERM", "TSTP", "USR2" or "WINCH"
+	;	(case insensitive), ALRM and USR1 are reserved for GT.M itself
+	s errno=$&posix.sigopen(.signals,.s)
+	q
+
+sigread(s,n) ; n: "signal" number (0 if none pending, see param) and "pid" of the sender
+	n signal,pid
+	k n
+	s errno=$&posix.sigread(.s,.signal,.pid)
+	s n("signal")=signal,n("pid")=pid
+	q
+
+sigclose(s) ; unblocks the signals of s
+	s errno=$&posix.sigclose(.s)
+	q
+
+
+; Scheduling
+
+; d setaffinity^posix("0-7,16")
+; w $$getaffinity^posix
+; d getcpu^posix(.cpu,.node)
+; d setpriority^posix(10)
+; d setscheduler^posix("BATCH")
+; d setmempolicy^posix("BIND","1")
+;
+setaffinity(cpus,pid) ; cpus: list as taskset -c, e.g. "0-7,16", pid: optional, the calling thread by default
+	; (the M thread, running asyslog writer and rmpath/walk threads keep their masks, new threads inherit it)
+	s errno=$&posix.setaffinity(+$g(pid),.cpus)
+	q
+
+getaffinity(pid) ; returns list of CPUs the thread (the M thread by default) can run on, e.g. "0-7,16"
+	n cpus
+	s errno=$&posix.getaffinity(+$g(pid),.cpus)
+	q cpus
+
+getcpu(cpu,node) ; non-POSIX (Linux), CPU and NUMA node the M thread is running on
+	s errno=$&posix.getcpu(.cpu,.node)
+	q
+
+setpriority(prio,which,who) ; nice value -20 (highest) to 19
+	; which: "PROCESS", "PGRP" or "USER" (case insensitive, optional, "PROCESS" by default), who: optional, 0 by default
+	s errno=$&posix.setpriority($g(which,"PROCESS"),+$g(who),.prio)
+	q
+
+getpriority(which,who) ; returns nice value
+	n prio
+	s errno=$&posix.getpriority($g(which,"PROCESS"),+$g(who),.prio)
+	q prio
+
+setscheduler(policy,priority,pid)
+	; policy: "OTHER", "BATCH", "IDLE", "FIFO" or "RR" (case insensitive), priority: 1-99 for "FIFO" and "RR" (optional)
+	; pid: optional, the calling (M) thread by default, like setaffinity
+	s errno=$&posix.setscheduler(+$g(pid),.policy,+$g(priority))
+	q
+
+getscheduler(priority,pid) ; returns policy name, sets priority
+	n policy
+	s errno=$&posix.getscheduler(+$g(pid),.policy,.priority)
+	q policy
+
+setmempolicy(mode,nodes) ; non-POSIX (Linux), NUMA memory placement of the M thread (threads started later inherit it)
+	; mode: "DEFAULT", "LOCAL", "BIND", "INTERLEAVE" or "PREFERRED" (case insensitive), nodes: list, e.g. "0-1"
+	s errno=$&posix.setmempolicy(.mode,$g(nodes))
+	q
+
+getmempolicy(nodes) ; returns mode, sets nodes
+	n mode
+	s errno=$&posix.getmempolicy(.mode,.nodes)
+	q mode
+
+
 ; Syslog
 
 ; d openlog^posix("TEST","PID|CONS","USER")
@@ -149,6 +542,67 @@ syslog(message,priority)
 	d &posix.syslog($g(priority,"NOTICE"),.message)
 	q
 
+;
+; d aopenlog^posix("TEST","PID","USER",8192)
+; d asyslog^posix("ABC")
+; d aflushlog^posix(1000)
+; d alogstat^posix(.n) zwrite n
+; d acloselog^posix
+;
+aopenlog(ident,option,facility,slots) ; starts background syslog writer, options as for openlog
+	; slots: ring size in 2KiB messages, rounded up to power of 2 (optional, default 512)
+	s errno=$&posix.aopenlog(.ident,$g(option),$g(facility,"USER"),+$g(slots))
+	q
+
+asyslog(message,priority) ; queues message, it is dropped when the ring is full
+	; falls back to syslog when aopenlog has not been called
+	d &posix.asyslog($g(priority,"NOTICE"),.message)
+	q
+
+aflushlog(timeout) ; waits up to timeout milliseconds until queued messages are sent
+	s errno=$&posix.aflushlog($g(timeout,1000))
+	q
+
+acloselog() ; sends queued messages and stops background writer
+	d &posix.acloselog()
+	q
+
+alogstat(n) ; queued, sent, dropped and failed message counters
+	n queued,sent,dropped,failed
+	d &posix.alogstat(.queued,.sent,.dropped,.failed)
+	k n
+	s n("queued")=queued,n("sent")=sent,n("dropped")=dropped,n("failed")=failed
+	q
+
+;
+; d netopenlog^posix("udp:loghost:514","TEST","LOCAL0")
+; s sd("origin","ip")="10.0.0.1",sd("meta@32473","seq")=1
+; d netsyslog^posix("ABC","INFO","LOGIN",.sd)
+; d netcloselog^posix
+;
+netopenlog(target,app,facility) ; RFC 5424 logger, target: "unix:/dev/log", "udp:host:port" or "tcp:host:port"
+	; app: APP-NAME (optional, defaults to ident given to openlog)
+	s errno=$&posix.netopenlog(.target,$g(app),$g(facility,"USER"))
+	q
+
+netsyslog(message,priority,msgid,sd) ; sd: structured data, sd(id,name)=value (optional)
+	n s,id,name
+	s s="",id="" f  s id=$o(sd(id)) q:id=""  d
+	. s s=s_"["_id,name=""
+	. f  s name=$o(sd(id,name)) q:name=""  s s=s_" "_name_"="""_$$sdescape(sd(id,name))_""""
+	. s s=s_"]"
+	s errno=$&posix.netsyslog($g(priority,"NOTICE"),$g(msgid),s,.message)
+	q
+
+sdescape(value) ; escapes '"', '\' and ']' in structured data param value
+	n s,c,i
+	s s="" f i=1:1:$l(value) s c=$e(value,i) s:"""\]"[c s=s_"\" s s=s_c
+	q s
+
+netcloselog()
+	d &posix.netcloselog()
+	q
+
 
 ; File Permissions
 
@@ -198,6 +652,16 @@ link(oldpath,newpath)
 	s errno=$&posix.link(.oldpath,.newpath)
 	q
 
+; d copyfile^posix("/data/j/a.mjl","/archive/a.mjl","ATOMIC|PRESERVE")
+;
+; non-POSIX, copies a file like cp, with reflink, copy_file_range or sendfile where supported
+copyfile(src,dst,flags)
+	; flags: "|" joined "ATOMIC", "EXCL", "MODE", "OWNER", "TIMES" or "PRESERVE" (case insensitive, optional)
+	;	"ATOMIC" copies to a temporary file renamed to dst when complete, "EXCL" fails if dst exists,
+	;	"PRESERVE" is "MODE|OWNER|TIMES", ownership is not preserved when not permitted
+	s errno=$&posix.copyfile(.src,.dst,$g(flags))
+	q
+
 ; d symlink^posix("/etc/passwd","/tmp/s1")
 ; w $$readlink^posix("/tmp/s1")
 ;
@@ -206,9 +670,9 @@ symlink(oldpath,newpath)
 	q
 
 readlink(path)
-	n p
-	s errno=$&posix.readlink(.path,.p)
-	q p
+	n l
+	s errno=$&posix.readlinkx(.path,.l)
+	q $$result(l)
 
 umask(mask) ; returns umask mode in octal representation, takes octal representation
 	q $$octal($&posix.umask($$mode(.mask)))
@@ -218,20 +682,18 @@ zbit(n,l) ; coverts l byte long M's integer to GT.M's zbitstring in big endian o
 	f i=l:-1:1 s $ze(b,i)=$zch(n#256),n=n\256
 	q $zch(0)_b
 	
-isflag(mode,flag)
-	n s
-	s s=$$zbit($$mode(.flag),4)
-	q $zbitand($$zbit(.mode,4),s)=s
+isflag(mode,flag) ; all permission bits in octal flag are set
+	q $&posix.sisflag(.mode,.flag)
 
-; M equivalent to POSIX macros for checking file type using stat's mode field (S_ISREG(m), S_ISDIR(m), ...)
+; POSIX macros for checking file type using stat's mode field (S_ISREG(m), S_ISDIR(m), ...)
 ; use on "mode" field returned from stat^posix
-isreg(mode)  q $$isflag(.mode,0100000) ; regular file
-isdir(mode)  q $$isflag(.mode,0040000) ; directory
-ischr(mode)  q $$isflag(.mode,0020000) ; character device
-isblk(mode)  q $$isflag(.mode,0060000) ; block device
-isfifo(mode) q $$isflag(.mode,0010000) ; FIFO
-islnk(mode)  q $$isflag(.mode,0120000) ; symbolic link
-issock(mode) q $$isflag(.mode,0140000) ; socket
+isreg(mode)  q $&posix.sisreg(.mode) ; regular file
+isdir(mode)  q $&posix.sisdir(.mode) ; directory
+ischr(mode)  q $&posix.sischr(.mode) ; character device
+isblk(mode)  q $&posix.sisblk(.mode) ; block device
+isfifo(mode) q $&posix.sisfifo(.mode) ; FIFO
+islnk(mode)  q $&posix.sislnk(.mode) ; symbolic link
+issock(mode) q $&posix.sissock(.mode) ; socket
 
 ; d stat^posix("/etc/passwd",.n)
 ; w $$octal^posix(n("mode"))
@@ -252,6 +714,55 @@ lstat(path,n)
 	s:'errno n("dev")=dev,n("ino")=ino,n("mode")=mode,n("nlink")=nlink,n("uid")=uid,n("gid")=gid,n("rdev")=rdev,n("size")=size,n("blksize")=blksize,n("blocks")=blocks,n("atime")=atime,n("mtime")=mtime,n("ctime")=ctime
 	q
 
+; s s=$$stats^posix("/etc/passwd") w "size: ",$p(s,"|",8),!
+; w $$exists^posix("/etc/passwd")
+;
+stats(path,nofollow) ; returns stat fields "|" joined, in the order of stat, "" on error
+	; dev|ino|mode|nlink|uid|gid|rdev|size|blksize|blocks|atime|mtime|ctime
+	; nofollow: 1 for lstat (optional)
+	n s
+	s errno=$&posix.stats(.path,+$g(nofollow),.s)
+	q s
+
+exists(path) ; returns 1 if path exists, errno is not set
+	q $&posix.exists(.path)
+
+; w $$ftype^posix("/etc",.octal)," ",octal
+;
+ftype(path,octal,nofollow) ; returns file type as scandir ("f", "d", "l", ...), octal is set to permissions as $$octal
+	; nofollow: 1 for lstat (optional)
+	n type
+	s errno=$&posix.ftype(.path,+$g(nofollow),.type,.octal)
+	q type
+
+; d statx^posix("/etc/passwd",.n,"SIZE|MTIME|BTIME")
+; s p(1)="/etc/passwd",p(2)="/etc/group" d statmany^posix(.p,.n,"SIZE") zwr n
+;
+statx(path,n,mask) ; non-POSIX (Linux), only the fields in mask, times with nanoseconds ("seconds.nanoseconds") and "btime"
+	; mask: "|" joined "INO", "MODE", "NLINK", "UID", "GID", "SIZE", "BLOCKS", "ATIME", "MTIME", "CTIME",
+	;	"BTIME", "BASIC" (all but "BTIME") or "ALL", and "NOFOLLOW" for lstat (case insensitive, optional, "ALL" by default)
+	; "dev", "rdev" and "blksize" are always set, fields not supported by the filesystem are not
+	n s
+	k n
+	s errno=$&posix.statx(.path,$g(mask),.s)
+	d:'errno statxrec(s,.n)
+	q
+
+statmany(paths,n,mask) ; stats paths(i) in bulk, n(i) is errno and n(i,field) the fields as statx
+	n s,l,o,i,j,k
+	k n
+	s l="",i="" f  s i=$o(paths(i)) q:i=""  s l=l_$s(l="":"",1:$c(10))_paths(i)
+	s i=$o(paths(""))
+	f  q:l=""  s errno=$&posix.statmany(.l,$g(mask),.o,.s) d  s l=$e(l,o+1,$l(l))
+	. f j=1:1:$l(s,$c(10)) s k=$p(s,$c(10),j),n(i)=+k d:'n(i) statxrec($p(k,"|",2,15),.n,i) s i=$o(paths(i))
+	q
+
+statxrec(s,n,i) ; sets n(field) (or n(i,field)) to non-empty fields of statx record s
+	n f,j,v
+	s f="dev|ino|mode|nlink|uid|gid|rdev|size|blksize|blocks|atime|mtime|ctime|btime"
+	f j=1:1:14 s v=$p(s,"|",j) i v'="" s:$d(i) n(i,$p(f,"|",j))=v s:'$d(i) n($p(f,"|",j))=v
+	q
+
 ; s dir=$$opendir^posix("/etc")
 ; f  s name=$$readdir^posix(.dir) q:name=""  w name,!
 ; d closedir^posix(.dir)
@@ -266,29 +777,198 @@ readdir(dir)
 	s errno=$&posix.readdir(.dir,.name)
 	q name
 
+; s dir=$$opendir^posix("/etc")
+; f  q:'$$readdirn^posix(.dir,.names)  s i="" f  s i=$o(names(i)) q:i=""  w names(i),!
+; d closedir^posix(.dir)
+;
+readdirn(dir,names,max) ; returns number of names read into names array, 0 at the end of directory
+	; max is optional, by default names are read until the buffer is full
+	n s,i,l
+	k names
+	s errno=$&posix.readdirn(.dir,$g(max,0),.s)
+	s l=$s(s="":0,1:$l(s,"/")) f i=1:1:l s names(i)=$p(s,"/",i)
+	q l
+
 closedir(dir)
 	s errno=$&posix.closedir(.dir)
 	q
 
-; non-POSIX, utility function like mkdir -p
-mkpath(path)
-	n l,i,s
-	s l=$l(path,"/") f i=1:1:l s s=$p(path,"/",1,i) d:s'=""
-	. d stat(s)
-	. d:errno mkdir($p(path,"/",1,i)) q:errno
+; d scandir^posix("/etc",.n)
+; d scandir^posix("/etc",.n,"STAT")
+; zwr
+;
+scandir(path,n,flags) ; non-POSIX, directory snapshot, n(name)=type with n(name,"ino"), n(name,"size") and n(name,"mtime")
+	; flags: "|" joined "STAT" or "FOLLOW" (case insensitive, optional)
+	;	"STAT" always stats the entries, otherwise size and mtime are set only when
+	;	the filesystem does not report the entry type, "FOLLOW" stats the symbolic links targets
+	; type: "f" regular file, "d" directory, "l" symbolic link, "c" character device,
+	;	"b" block device, "p" FIFO, "s" socket or "?" unknown
+	n c,s,r,i,name
+	k n
+	s c=0
+	f  q:c<0  s errno=$&posix.scandir(.path,$g(flags),.c,.s) f i=1:1:$l(s,"/") s r=$p(s,"/",i) d:r'=""
+	. s name=$p(r,"|",5,$l(r,"|")),n(name)=$p(r,"|"),n(name,"ino")=$p(r,"|",2)
+	. s:$p(r,"|",3)'="" n(name,"size")=$p(r,"|",3),n(name,"mtime")=$p(r,"|",4)
+	q
+
+; d mkpath^posix("/tmp/a/b/c")
+; d tryrmpath^posix("/tmp/a",1,.failed) w:errno failed," ",$$strerror^posix(errno),!
+;
+; non-POSIX, utility function like mkdir -p, see umask
+mkpath(path,mode,failed) ; failed is set to the path which could not be created
+	s errno=$&posix.mkpath(.path,$$mode($g(mode,755)),.failed)
 	q
 
 ; non-POSIX, utility function like rm -r
-rmpath(path)
-	n n,s
-	d lstat(path,.n) q:errno
-	i $$isdir(n("mode")) d  q:errno
-	. n d
-	. s d=$$opendir(.path) q:errno
-	. f  s s=$$readdir(.d) q:s=""  d:s'="."&(s'="..") rmpath(path_"/"_s) q:errno
-	. d closedir(.d)
-	. d rmdir(.path)
-	e  d:'errno unlink(.path)
+rmpath(path,threads,failed) ; failed is set to the path which could not be removed
+	; threads: number of threads removing the directories in parallel (optional, 1 by default)
+	s errno=$&posix.rmpath(.path,$g(threads,1),.failed)
+	q
+
+trymkpath(path,mode,failed) ; mkpath which does not raise an exception
+	s errno=$&posix.trymkpath(.path,$$mode($g(mode,755)),.failed)
+	q
+
+tryrmpath(path,threads,failed) ; rmpath which does not raise an exception
+	s errno=$&posix.tryrmpath(.path,$g(threads,1),.failed)
+	q
+
+; d walk^posix("/usr",.n,4)
+; zwr
+;
+; non-POSIX, utility function like du, counts the entries of the directory tree
+walk(path,n,threads,failed) ; n: "dirs", "files", "links", "others", "size" and "blocks" (st_blocks) totals, latest "mtime"
+	; threads: number of threads reading the directories in parallel (optional, 1 by default)
+	n dirs,files,links,others,size,blocks,mtime
+	k n
+	s errno=$&posix.walk(.path,$g(threads,1),.failed,.dirs,.files,.links,.others,.size,.blocks,.mtime)
+	s:'errno n("dirs")=dirs,n("files")=files,n("links")=links,n("others")=others,n("size")=size,n("blocks")=blocks,n("mtime")=mtime
+	q
+
+
+; File Descriptors
+
+; d open^posix("/tmp/export.dat",.fd,"WRONLY|CREAT",644)
+; d fallocate^posix(fd,0,1048576*100)
+; d pwrite^posix(fd,0,"header"_$c(10))
+; d fadvise^posix(fd,0,0,"DONTNEED")
+; d close^posix(fd)
+;
+open(path,fd,flags,mode) ; see umask
+	; flags: "|" joined "RDONLY", "WRONLY", "RDWR", "APPEND", "CREAT", "EXCL", "TRUNC",
+	;	"DSYNC", "SYNC", "NOATIME" or "NOFOLLOW" (case insensitive, optional, "RDONLY" by default)
+	s errno=$&posix.open(.path,$g(flags,"RDONLY"),$$mode($g(mode,644)),.fd)
+	q
+
+pread(fd,offset,len) ; returns up to len (at most 1MiB) bytes read at 0 based offset, less at the end of file
+	n s
+	s errno=$&posix.pread(.fd,.offset,.len,.s)
+	q s
+
+pwrite(fd,offset,s) ; writes s at 0 based offset, the file offset is not changed
+	s errno=$&posix.pwrite(.fd,.offset,.s)
+	q
+
+fsync(fd)
+	s errno=$&posix.fsync(.fd)
+	q
+
+fdatasync(fd)
+	s errno=$&posix.fdatasync(.fd)
+	q
+
+fallocate(fd,offset,len) ; preallocates len bytes at 0 based offset
+	s errno=$&posix.fallocate(.fd,.offset,.len)
+	q
+
+fadvise(fd,offset,len,advice) ; len 0 means up to the end of file
+	; advice: "NORMAL", "SEQUENTIAL", "RANDOM", "NOREUSE", "WILLNEED" or "DONTNEED" (case insensitive)
+	s errno=$&posix.fadvise(.fd,.offset,.len,.advice)
+	q
+
+close(fd)
+	s errno=$&posix.close(.fd)
+	q
+
+read(fd,len,eof) ; returns up to len (at most 1MiB) bytes available in a pipe or other stream
+	; eof: 1 at the end of file, "" with eof 0 means no data is available yet on "NONBLOCK" pipes
+	n s
+	s errno=$&posix.read(.fd,.len,.s,.eof)
+	q s
+
+write(fd,s) ; returns number of bytes written to a pipe or other stream, less than $zl(s) (even 0) only for
+	; "NONBLOCK" pipes
+	n w
+	s errno=$&posix.write(.fd,.s,.w)
+	q w
+
+
+; Memory Mapped Files
+
+; d mmap^posix("/data/feed.dat",.h,"RANDOM",.size)
+; s o=0 f  s e=$$mfind^posix(h,o,$c(10)) q:e<0  w $$mread^posix(h,o,e-o),! s o=e+1
+; d munmap^posix(h)
+;
+mmap(path,h,flags,size) ; maps the file read-only, size is set to the file size
+	; flags: "|" joined "POPULATE", "RANDOM", "SEQUENTIAL", "WILLNEED" or "HUGEPAGE" (case insensitive, optional)
+	s errno=$&posix.mmap(.path,$g(flags),.h,.size)
+	q
+
+mread(h,offset,len) ; returns up to len (at most 1MiB) bytes at 0 based offset, "" past the end of file
+	n s
+	s errno=$&posix.mread(.h,.offset,.len,.s)
+	q s
+
+mfind(h,offset,char) ; returns 0 based offset of the first char at or after offset, -1 if not found
+	n pos
+	s errno=$&posix.mfind(.h,.offset,$za(char),.pos)
+	q pos
+
+;
+; s pos=0 f  q:pos<0  s r=$$mnext^posix(h,.pos) w $p(r,"|",2),!
+; s pos=0 f  q:pos<0  s n=$$mnextn^posix(h,.pos,.s,1000) f i=1:1:n w $p(s,$c(10),i),!
+;
+mnext(h,pos,delim) ; returns the record at 0 based offset pos and advances pos past the delimiter, pos is -1 at the end
+	; delim: record delimiter (optional, $c(10) by default)
+	n s
+	s errno=$&posix.mnext(.h,.pos,$g(delim,$c(10)),.s)
+	q s
+
+mnextn(h,pos,s,max,delim) ; returns number of records (up to max) in s, joined with delim, as mnext
+	n n
+	s errno=$&posix.mnextn(.h,.pos,$g(delim,$c(10)),$g(max,1000),.s,.n)
+	q n
+
+munmap(h)
+	s errno=$&posix.munmap(.h)
+	q
+
+
+; Watch
+
+; d watch^posix("/data/in",.h,"CLOSE_WRITE|MOVED_TO")
+; f  s n=$$wpoll^posix(h,1000,.ev) f i=1:1:n w ev(i,"events")," ",ev(i,"name"),!
+; d unwatch^posix(h)
+;
+watch(path,h,events) ; non-POSIX, inotify(7) watch of a directory or file
+	; events: "|" joined "ACCESS", "ATTRIB", "CLOSE_WRITE", "CLOSE_NOWRITE", "CREATE", "DELETE",
+	;	"DELETE_SELF", "MODIFY", "MOVE_SELF", "MOVED_FROM", "MOVED_TO", "OPEN", or "CLOSE", "MOVE",
+	;	"ALL" (case insensitive, optional, "ALL" by default)
+	s errno=$&posix.watch(.path,$g(events),.h)
+	q
+
+wpoll(h,timeout,ev) ; waits up to timeout milliseconds (-1 forever) and returns number of events, 0 on timeout
+	; ev(i,"events"): "," joined event names, also "ISDIR", "IGNORED", "UNMOUNT" or "Q_OVERFLOW"
+	; ev(i,"name"): file name, "" for the watched path itself
+	; ev(i,"cookie"): links "MOVED_FROM" and "MOVED_TO" events of one rename
+	n s,n,i,r
+	k ev
+	s errno=$&posix.wpoll(.h,$g(timeout,-1),.s,.n)
+	f i=1:1:n s r=$p(s,"/",i),ev(i,"events")=$p(r,"|"),ev(i,"cookie")=$p(r,"|",2),ev(i,"name")=$p(r,"|",3,$l(r,"|"))
+	q n
+
+unwatch(h)
+	s errno=$&posix.unwatch(.h)
 	q
 
 
@@ -298,37 +978,72 @@ rmpath(path)
 ; zwr
 ;
 getpwnam(user,n)
-	n name,passwd,uid,gid,gecos,dir,shell
-	k n
-	s errno=$&posix.getpwnam(.user,.name,.passwd,.uid,.gid,.gecos,.dir,.shell)
-	s:'errno n("name")=name,n("passwd")=passwd,n("uid")=uid,n("gid")=gid,n("dir")=dir,n("shell")=shell,n("gecos","fullname")=$p(gecos,",",1),n("gecos","office")=$p(gecos,",",2),n("gecos","workphone")=$p(gecos,",",3),n("gecos","homephone")=$p(gecos,",",4)
+	n l
+	s errno=$&posix.getpwnamx(.user,.l)
+	d pwent($$result(l),.n)
 	q
 
 getpwuid(id,n)
-	n name,passwd,uid,gid,gecos,dir,shell
+	n l
+	s errno=$&posix.getpwuidx(.id,.l)
+	d pwent($$result(l),.n)
+	q
+
+; w $$getpwent^posix("root")
+;
+getpwent(user) ; non-POSIX, returns passwd(5) line of user
+	n l
+	s errno=$&posix.getpwnamx(.user,.l)
+	q $$result(l)
+
+pwent(s,n) ; sets n to passwd(5) line s fields
+	n gecos
 	k n
-	s errno=$&posix.getpwuid(.id,.name,.passwd,.uid,.gid,.gecos,.dir,.shell)
-	s:'errno n("name")=name,n("passwd")=passwd,n("uid")=uid,n("gid")=gid,n("dir")=dir,n("shell")=shell,n("gecos","fullname")=$p(gecos,",",1),n("gecos","office")=$p(gecos,",",2),n("gecos","workphone")=$p(gecos,",",3),n("gecos","homephone")=$p(gecos,",",4)
+	q:s=""
+	s gecos=$p(s,":",5)
+	s n("name")=$p(s,":",1),n("passwd")=$p(s,":",2),n("uid")=$p(s,":",3),n("gid")=$p(s,":",4),n("dir")=$p(s,":",6),n("shell")=$p(s,":",7),n("gecos","fullname")=$p(gecos,",",1),n("gecos","office")=$p(gecos,",",2),n("gecos","workphone")=$p(gecos,",",3),n("gecos","homephone")=$p(gecos,",",4)
 	q
 
 getgrnam(group,n)
-	n name,passwd,gid,mem
-	k n
-	s errno=$&posix.getgrnam(.group,.name,.passwd,.gid,.mem)
-	s:'errno n("name")=name,n("passwd")=passwd,n("gid")=gid,n("mem")=mem
+	n l
+	s errno=$&posix.getgrnamx(.group,.l)
+	d grent($$result(l),.n)
 	q
 
 getgrgid(id,n)
-	n name,passwd,gid,mem
+	n l
+	s errno=$&posix.getgrgidx(.id,.l)
+	d grent($$result(l),.n)
+	q
+
+; w $$getgrent^posix("root")
+;
+getgrent(group) ; non-POSIX, returns group(5) line of group
+	n l
+	s errno=$&posix.getgrnamx(.group,.l)
+	q $$result(l)
+
+grent(s,n) ; sets n to group(5) line s fields, "mem" is "|" joined
 	k n
-	s errno=$&posix.getgrgid(.id,.name,.passwd,.gid,.mem)
-	s:'errno n("name")=name,n("passwd")=passwd,n("gid")=gid,n("mem")=mem
+	q:s=""
+	s n("name")=$p(s,":",1),n("passwd")=$p(s,":",2),n("gid")=$p(s,":",3),n("mem")=$tr($p(s,":",4),",","|")
 	q
 
 ; w $$getgrouplist^posix("root")
 ;
-getgrouplist(user) ; non-POSIX, portable version
-	n list
-	s errno=$&posix.getgrouplist(.user,.list)
-	q list
+getgrouplist(user) ; non-POSIX, "|" joined names of the groups of user, including the primary group, see nsscache
+	n l
+	s errno=$&posix.getgrouplistx(.user,.l)
+	q $$result(l)
+
+; d nsscache^posix(300,30)
+;
+nsscache(ttl,negttl) ; non-POSIX, caches passwd and group lookups for ttl seconds, not found for negttl seconds
+	; 0 disables caching (the default), both flush the cache
+	s errno=$&posix.nsscache(+$g(ttl),+$g(negttl))
+	q
+
+nssflush() ; drops cached passwd and group entries
+	d &posix.nssflush()
+	q
 